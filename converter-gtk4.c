@@ -2,6 +2,7 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <unistd.h>
@@ -11,26 +12,90 @@
 #define PYTHON_PROG "python3"
 #define YTDLP_PATH  "./libs/yt-dlp"
 
-/* single temp file for the downloaded input */
-#define YTDLP_TMP_FILE "/tmp/ytdlp_input.mkv"
+/* scratch space: each download gets its own workspace, on tmpfs when the
+   expected size is small and on the scratch disk otherwise (the disk can
+   be overridden with $BETINHA_SCRATCH_DIR). Workspaces are named
+   SCRATCH_PREFIX<pid>-<job id> so leftovers of a crashed run can be
+   recognized and removed at startup. */
+#define SCRATCH_TMPFS_DIR    "/dev/shm"
+#define SCRATCH_DISK_DIR     "/var/tmp"
+#define SCRATCH_PREFIX       "betinha-"
+#define SCRATCH_MANIFEST_EXT ".partials"          /* "betinha-<pid>.partials": temp outputs of a run */
+#define SCRATCH_TMPFS_MAX    ((guint64)512 << 20) /* largest workspace put in RAM */
+#define SCRATCH_DEFAULT_SIZE ((guint64)2 << 30)   /* expected download when yt-dlp can't tell */
+#define SCRATCH_MARGIN       ((guint64)256 << 20) /* always left free on a filesystem */
+
+/* download scheduler: concurrent yt-dlp processes and rebalancing period;
+   the global bandwidth cap itself is set in the UI */
+#define DL_MAX_CONCURRENT 2
+#define DL_TICK_MS        250
+#define DL_BURST_SEC      1.0   /* bucket depth, in seconds of a job's share */
+
+/* draft pass: quick low-res preview that the full-quality encode replaces */
+#define DRAFT_HEIGHT  360
+#define DRAFT_GIF_FPS 8
+
+/* live preview: loopback HTTP server for MP4 outputs still being written
+   (0 = let the OS pick a free port) */
+#define PREVIEW_PORT      0
+#define PREVIEW_POLL_MS   200   /* how often a stream waiting for more data rechecks */
+#define PREVIEW_CHUNK     65536
+#define PREVIEW_TIMEOUT_SEC 30  /* drop clients that stall on a read or write */
+#define PREVIEW_MAX_HEAD  8192  /* request line + headers, bytes */
+#define PREVIEW_MAX_LINES 32    /* request line + headers, lines */
+
+/* formats offered in the UI (order matches format_dropdown) */
+#define N_FORMATS 6
+static const char *FORMATS[N_FORMATS + 1] = {"PNG", "JPEG", "WEBP", "GIF", "MP4", "MP3", NULL};
 
 /* ---------- app state ---------- */
 
 typedef enum {
     PHASE_IDLE = 0,
     PHASE_DOWNLOADING,
+    PHASE_DRAFTING,
     PHASE_TRANSCODING
 } Phase;
 
+/* one target of a (possibly fanned-out) conversion */
 typedef struct {
-    GtkEntry       *input_entry;
-    GtkEntry       *output_entry;
-    GtkDropDown    *format_dropdown;
+    char           *format;   /* "MP4", "GIF", ... */
+    gint            height;   /* target height in px, 0 = keep source size */
+    char           *path;     /* final output file */
+    char           *partial;  /* temp file renamed over path on success, NULL = write path directly */
+    char           *draft;    /* temp file for the quick draft, renamed over path once it is complete */
+    gboolean        draft_left; /* path holds the committed draft until the final pass replaces it */
+    gboolean        fragmented; /* MP4 written as fragments, playable while encoding */
+} OutputSpec;
+
+/* loopback HTTP server for live previews; connections are handled on
+   worker threads, so everything they read from the job side is a copy
+   kept in files under lock */
+typedef struct {
+    GSocketService *service;
+    guint16         port;
+    GMutex          lock;
+    GHashTable     *files;    /* job id -> PreviewFile* */
+} PreviewServer;
+
+typedef struct {
+    char           *path;     /* file currently being written for this job */
+    gboolean        writing;  /* encoder still appending to path */
+} PreviewFile;
+
+typedef struct _AppWidgets AppWidgets;
+
+/* one submitted conversion: optional download, then draft/final encode */
+typedef struct {
+    AppWidgets     *app;
+    guint           id;
+
+    /* row in the jobs list */
     GtkProgressBar *progress_bar;
     GtkLabel       *progress_label; /* ETA label */
     GtkLabel       *status_label;
-    GtkButton      *convert_btn;
-    GtkButton      *cancel_btn;
+    GtkLabel       *preview_label;  /* preview URL, live preview jobs only */
+    GtkButton      *cancel_btn;     /* cancels just this job */
 
     /* processes */
     GPid            yt_pid;
@@ -40,9 +105,17 @@ typedef struct {
     GIOChannel     *yt_io;       /* stdout from yt-dlp */
     GIOChannel     *ff_io;       /* stderr from ffmpeg (-progress pipe:2) */
 
-    /* media info */
+    /* media info (downloaded/probed once, shared by draft and final encodes) */
+    char           *url;            /* YouTube URL, NULL for local files */
+    char           *input_path;     /* local file or downloaded temp file */
     gdouble         total_duration; /* seconds (media) for ffmpeg stage */
 
+    /* targets of this job, all produced by a single ffmpeg pass */
+    GPtrArray      *outputs;        /* OutputSpec* */
+    gboolean        draft_mode;     /* encode a low-res draft first */
+    OutputSpec     *preview;        /* MP4 output served live, NULL = no preview */
+    char           *skipped;        /* audio outputs dropped for a silent input, for the final status */
+
     /* unified ETA model (wall clock) */
     Phase           phase;
     gint64          t_start_us;        /* monotonic at overall start */
@@ -51,8 +124,59 @@ typedef struct {
     gdouble         dl_progress_0_1;   /* fraction within download */
     gdouble         tx_progress_0_1;   /* fraction within transcode */
 
+    /* download scheduling (see dl_sched_*) */
+    gint            priority;          /* weight of this job's bandwidth share */
+    gboolean        dl_paused;         /* SIGSTOPped to stay within its share */
+    gdouble         dl_bytes;          /* downloaded bytes, last progress line */
+    gdouble         dl_bytes_tick;     /* dl_bytes at the previous scheduler tick */
+    gdouble         dl_speed;          /* bytes/s, last progress line */
+    gdouble         dl_credit;         /* token bucket, bytes */
+    gdouble         dl_share_bps;      /* current allotment, 0 = unlimited */
+    gboolean        probed;            /* size/info probe has run (or was skipped) */
+    GSubprocess    *probe;             /* running probe, holds a download slot */
+    char           *probe_dir;         /* private workspace holding info_json */
+    char           *info_json;         /* probe's extraction, reused by the download */
+
+    /* scratch space and free-space reservations (see scratch_*) */
+    guint64         expected_bytes;    /* probed/stat'ed input size, 0 = unknown */
+    char           *scratch_dir;       /* per-job workspace, NULL if none */
+    guint64         scratch_bytes;     /* reserved on scratch_dev */
+    dev_t           scratch_dev;
+    guint64         out_bytes;         /* reserved on out_dev for outputs */
+    dev_t           out_dev;
+
+    gboolean        active;            /* queued or running */
     gboolean        cancel_requested;
-} AppWidgets;
+} Job;
+
+struct _AppWidgets {
+    GtkEntry       *input_entry;
+    GtkEntry       *output_entry;
+    GtkDropDown    *format_dropdown;
+    GtkCheckButton *extra_checks[N_FORMATS]; /* "also produce" formats */
+    GtkEntry       *sizes_entry;             /* optional heights, e.g. "720,480" */
+    GtkCheckButton *draft_check;             /* quick draft before the final encode */
+    GtkCheckButton *live_check;              /* fragmented MP4 + preview server */
+    GtkSpinButton  *priority_spin;           /* priority of the next submitted job */
+    GtkSpinButton  *bw_cap_spin;             /* global download cap, KiB/s (0 = unlimited) */
+    GtkListBox     *jobs_list;
+    GtkLabel       *status_label;
+    GtkButton      *convert_btn;
+    GtkButton      *cancel_btn;
+
+    GPtrArray      *jobs;           /* Job*, everything submitted this session */
+    guint           next_job_id;
+
+    PreviewServer  *preview;        /* started with the first live preview job */
+
+    /* download scheduler */
+    GPtrArray      *dl_waiting;     /* Job*, highest priority first */
+    GPtrArray      *dl_running;     /* Job* with a live yt-dlp */
+    GPtrArray      *local_waiting;  /* local-file Job* waiting for disk space, oldest first */
+    guint           dl_tick_id;
+    gint64          dl_tick_us;     /* monotonic at the previous tick */
+    guint           dl_pump_id;     /* deferred dl_sched_pump after a job ends */
+};
 
 /* ---------- helpers ---------- */
 
@@ -66,24 +190,90 @@ is_youtube_url(const char *url)
            g_str_has_prefix(url, "http://youtu.be/");
 }
 
-static char *
-append_extension_if_missing(const char *path, const char *format)
+static const char *
+format_extension(const char *format)
 {
-    if (!path || !format) return NULL;
-
-    const char *ext =
+    return
         g_strcmp0(format, "PNG")  == 0 ? ".png"  :
         g_strcmp0(format, "JPEG") == 0 ? ".jpg"  :
         g_strcmp0(format, "WEBP") == 0 ? ".webp" :
         g_strcmp0(format, "GIF")  == 0 ? ".gif"  :
         g_strcmp0(format, "MP4")  == 0 ? ".mp4"  :
         g_strcmp0(format, "MP3")  == 0 ? ".mp3"  : "";
+}
+
+static gboolean
+is_image_format(const char *format)
+{
+    return g_strcmp0(format, "PNG")  == 0 ||
+           g_strcmp0(format, "JPEG") == 0 ||
+           g_strcmp0(format, "WEBP") == 0;
+}
+
+static gboolean
+is_audio_format(const char *format)
+{
+    return g_strcmp0(format, "MP3") == 0;
+}
+
+static char *
+append_extension_if_missing(const char *path, const char *format)
+{
+    if (!path || !format) return NULL;
+
+    const char *ext = format_extension(format);
 
     if (!*ext) return g_strdup(path);
     if (g_str_has_suffix(path, ext)) return g_strdup(path);
     return g_strconcat(path, ext, NULL);
 }
 
+/* "out/clip.mp4" -> "out/clip" for any extension we know how to produce */
+static char *
+strip_known_extension(const char *path)
+{
+    for (int i = 0; FORMATS[i]; i++) {
+        const char *ext = format_extension(FORMATS[i]);
+        if (g_str_has_suffix(path, ext))
+            return g_strndup(path, strlen(path) - strlen(ext));
+    }
+    return g_strdup(path);
+}
+
+/* ("out/clip.mp4", "part") -> "out/.clip.betinha-<pid>.part.mp4": same
+   directory (so rename is atomic), same extension (so ffmpeg still picks
+   the muxer from it), and the pid so a later run can tell whose it is */
+static char *
+make_temp_path(const char *path, const char *tag)
+{
+    char *dir = g_path_get_dirname(path);
+    char *base = g_path_get_basename(path);
+    char *dot = strrchr(base, '.');
+    char *name;
+    if (dot && dot != base) {
+        *dot = '\0';
+        name = g_strdup_printf(".%s." SCRATCH_PREFIX "%d.%s.%s", base, (int)getpid(), tag, dot + 1);
+    } else {
+        name = g_strdup_printf(".%s." SCRATCH_PREFIX "%d.%s", base, (int)getpid(), tag);
+    }
+    char *tmp = g_build_filename(dir, name, NULL);
+    g_free(name);
+    g_free(base);
+    g_free(dir);
+    return tmp;
+}
+
+static void
+output_spec_free(gpointer data)
+{
+    OutputSpec *o = data;
+    g_free(o->format);
+    g_free(o->path);
+    g_free(o->partial);
+    g_free(o->draft);
+    g_free(o);
+}
+
 static gboolean
 ensure_output_path(const char *filepath, GError **error)
 {
@@ -102,17 +292,30 @@ ensure_output_path(const char *filepath, GError **error)
             return FALSE;
         }
     }
-    g_free(dirpath);
 
-    FILE *fp = fopen(filepath, "wb");
-    if (!fp) {
+    /* the file itself is only created by renaming a finished partial */
+    if (access(dirpath, W_OK) != 0) {
         int err = errno;
         g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
-                    "Cannot create file '%s': %s",
-                    filepath, g_strerror(err));
+                    "Cannot write to '%s': %s",
+                    dirpath, g_strerror(err));
+        g_free(dirpath);
         return FALSE;
     }
-    fclose(fp);
+    g_free(dirpath);
+
+    /* ...which would happily replace a read-only file, and fail only at
+       the very end on a directory: refuse both before any work is done */
+    struct stat st;
+    if (stat(filepath, &st) == 0) {
+        int err = S_ISDIR(st.st_mode) ? EISDIR
+                : access(filepath, W_OK) != 0 ? errno : 0;
+        if (err) {
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                        "Cannot replace '%s': %s", filepath, g_strerror(err));
+            return FALSE;
+        }
+    }
     return TRUE;
 }
 
@@ -152,32 +355,980 @@ get_media_duration(const char *input)
     return d > 0 ? d : 0.0;
 }
 
+/* Does input have an audio stream? TRUE when ffprobe can't tell, so an
+   unknown input is left to ffmpeg as before */
+static gboolean
+media_has_audio(const char *input)
+{
+    gchar *argv[] = {
+        "ffprobe", "-v", "error",
+        "-select_streams", "a",
+        "-show_entries", "stream=index",
+        "-of", "csv=p=0",
+        (gchar *)input, NULL
+    };
+
+    gchar *out = NULL;
+    gint status = 0;
+    gboolean ok = g_spawn_sync(NULL, argv, NULL, G_SPAWN_SEARCH_PATH,
+                               NULL, NULL, &out, NULL, &status, NULL);
+    gboolean has = !ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+                   (out && *g_strstrip(out));
+    g_free(out);
+    return has;
+}
+
+/* ---------- output targets (single-pass fan-out) ---------- */
+
+/* Selected formats x sizes -> OutputSpecs. The dropdown format comes first,
+   "also produce" checks add more; sizes are target heights ("720,480p"). */
+static GPtrArray *
+collect_outputs(AppWidgets *w, const char *output_raw, GError **error)
+{
+    guint sel = gtk_drop_down_get_selected(w->format_dropdown);
+    GPtrArray *formats = g_ptr_array_new();
+    if (sel < N_FORMATS) g_ptr_array_add(formats, (gpointer)FORMATS[sel]);
+    for (guint i = 0; i < N_FORMATS; i++) {
+        if (i != sel && gtk_check_button_get_active(w->extra_checks[i]))
+            g_ptr_array_add(formats, (gpointer)FORMATS[i]);
+    }
+
+    GArray *heights = g_array_new(FALSE, FALSE, sizeof(gint));
+    const char *sizes = gtk_editable_get_text(GTK_EDITABLE(w->sizes_entry));
+    gchar **tokens = g_strsplit_set(sizes ? sizes : "", ", ", -1);
+    for (int i = 0; tokens[i]; i++) {
+        if (!*tokens[i]) continue;
+        char *end = NULL;
+        gint64 h = g_ascii_strtoll(tokens[i], &end, 10);
+        if (end && (*end == 'p' || *end == 'P')) end++;
+        if (h <= 0 || h > 8640 || (end && *end)) {
+            g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                        "Invalid size '%s' (expected heights like 720,480).",
+                        tokens[i]);
+            g_strfreev(tokens);
+            g_array_unref(heights);
+            g_ptr_array_unref(formats);
+            return NULL;
+        }
+        gboolean dup = FALSE;
+        for (guint j = 0; j < heights->len; j++)
+            if (g_array_index(heights, gint, j) == (gint)h) dup = TRUE;
+        if (!dup) {
+            gint hv = (gint)h;
+            g_array_append_val(heights, hv);
+        }
+    }
+    g_strfreev(tokens);
+    if (heights->len == 0) {
+        gint keep = 0;
+        g_array_append_val(heights, keep);
+    }
+
+    /* a single plain target keeps exactly the name that was typed */
+    gboolean single = formats->len == 1 && heights->len == 1 &&
+                      g_array_index(heights, gint, 0) == 0;
+    char *base = strip_known_extension(output_raw);
+
+    GPtrArray *outputs = g_ptr_array_new_with_free_func(output_spec_free);
+    for (guint f = 0; f < formats->len; f++) {
+        const char *fmt = formats->pdata[f];
+        /* sizes don't apply to audio: one MP3 regardless */
+        guint nh = is_audio_format(fmt) ? 1 : heights->len;
+        for (guint h = 0; h < nh; h++) {
+            OutputSpec *o = g_new0(OutputSpec, 1);
+            o->format = g_strdup(fmt);
+            o->height = is_audio_format(fmt) ? 0 : g_array_index(heights, gint, h);
+            if (single)
+                o->path = append_extension_if_missing(output_raw, fmt);
+            else if (o->height > 0)
+                o->path = g_strdup_printf("%s_%dp%s", base, o->height, format_extension(fmt));
+            else
+                o->path = g_strconcat(base, format_extension(fmt), NULL);
+            g_ptr_array_add(outputs, o);
+        }
+    }
+
+    g_free(base);
+    g_array_unref(heights);
+    g_ptr_array_unref(formats);
+    return outputs;
+}
+
+/* Fragmented MP4: an empty moov up front and a moof/mdat pair at least
+   every second, so everything written so far is already playable */
+static void
+add_fragment_args(GPtrArray *argv, OutputSpec *o)
+{
+    if (!o->fragmented) return;
+    g_ptr_array_add(argv, g_strdup("-movflags"));
+    g_ptr_array_add(argv, g_strdup("+frag_keyframe+empty_moov+default_base_moof"));
+    g_ptr_array_add(argv, g_strdup("-frag_duration"));
+    g_ptr_array_add(argv, g_strdup("1000000"));
+}
+
+/* ffmpeg argv producing every output from one demux/decode of the input.
+   Outputs that need video share one decoded stream through split, each
+   branch scaled to its own height; the whole pass reports a single
+   -progress stream on stderr. A draft pass caps every branch at DRAFT_HEIGHT
+   and uses the fastest encoder settings. NULL-terminated, free with
+   g_ptr_array_unref. */
+static GPtrArray *
+build_ffmpeg_argv(const char *input, GPtrArray *outputs, gboolean draft)
+{
+    GPtrArray *argv = g_ptr_array_new_with_free_func(g_free);
+    g_ptr_array_add(argv, g_strdup("ffmpeg"));
+    g_ptr_array_add(argv, g_strdup("-y"));
+    g_ptr_array_add(argv, g_strdup("-i"));
+    g_ptr_array_add(argv, g_strdup(input));
+    g_ptr_array_add(argv, g_strdup("-progress"));
+    g_ptr_array_add(argv, g_strdup("pipe:2"));   /* key=value machine lines on stderr */
+    g_ptr_array_add(argv, g_strdup("-nostats")); /* we rely on -progress */
+
+    OutputSpec *first = outputs->pdata[0];
+    if (!draft && outputs->len == 1 && first->height == 0) {
+        /* plain conversion: let ffmpeg pick the streams */
+        add_fragment_args(argv, first);
+        g_ptr_array_add(argv, g_strdup(first->partial ? first->partial : first->path));
+        g_ptr_array_add(argv, NULL);
+        return argv;
+    }
+
+    guint n_video = 0;
+    for (guint i = 0; i < outputs->len; i++) {
+        OutputSpec *o = outputs->pdata[i];
+        if (!is_audio_format(o->format)) n_video++;
+    }
+
+    if (n_video > 0) {
+        /* [0:v]split=2[s0][s1];[s0]null[v0];[s1]scale=-2:480[v1] */
+        GString *graph = g_string_new(NULL);
+        if (n_video > 1) {
+            g_string_append_printf(graph, "[0:v]split=%u", n_video);
+            for (guint i = 0; i < n_video; i++)
+                g_string_append_printf(graph, "[s%u]", i);
+        }
+        guint v = 0;
+        for (guint i = 0; i < outputs->len; i++) {
+            OutputSpec *o = outputs->pdata[i];
+            if (is_audio_format(o->format)) continue;
+            if (graph->len) g_string_append_c(graph, ';');
+            if (n_video > 1) g_string_append_printf(graph, "[s%u]", v);
+            else             g_string_append(graph, "[0:v]");
+            if (draft) {
+                gint h = (o->height > 0 && o->height < DRAFT_HEIGHT) ? o->height : DRAFT_HEIGHT;
+                if (g_strcmp0(o->format, "GIF") == 0)
+                    g_string_append_printf(graph, "fps=%d,", DRAFT_GIF_FPS);
+                g_string_append_printf(graph, "scale=-2:'min(%d,ih)'", h);
+            } else if (o->height > 0) {
+                g_string_append_printf(graph, "scale=-2:%d", o->height);
+            } else {
+                g_string_append(graph, "null");
+            }
+            g_string_append_printf(graph, "[v%u]", v);
+            v++;
+        }
+        g_ptr_array_add(argv, g_strdup("-filter_complex"));
+        g_ptr_array_add(argv, g_string_free(graph, FALSE));
+    }
+
+    guint v = 0;
+    for (guint i = 0; i < outputs->len; i++) {
+        OutputSpec *o = outputs->pdata[i];
+        g_ptr_array_add(argv, g_strdup("-map"));
+        if (is_audio_format(o->format)) {
+            g_ptr_array_add(argv, g_strdup("0:a:0"));
+        } else {
+            g_ptr_array_add(argv, g_strdup_printf("[v%u]", v++));
+            if (g_strcmp0(o->format, "MP4") == 0) {
+                g_ptr_array_add(argv, g_strdup("-map"));
+                g_ptr_array_add(argv, g_strdup("0:a:0?"));
+                if (draft) {
+                    const char *fast[] = {
+                        "-c:v", "libx264", "-preset", "ultrafast", "-crf", "32",
+                        "-b:a", "64k", NULL
+                    };
+                    for (int k = 0; fast[k]; k++)
+                        g_ptr_array_add(argv, g_strdup(fast[k]));
+                }
+            } else if (is_image_format(o->format)) {
+                g_ptr_array_add(argv, g_strdup("-frames:v"));
+                g_ptr_array_add(argv, g_strdup("1"));
+            }
+        }
+        add_fragment_args(argv, o);
+        /* never write the final path directly: a killed pass would leave it truncated */
+        const char *target = draft ? o->draft : o->partial;
+        g_ptr_array_add(argv, g_strdup(target ? target : o->path));
+    }
+    g_ptr_array_add(argv, NULL);
+    return argv;
+}
+
 /* ---------- unified progress/ETA ---------- */
 
 static void
-update_unified_progress(AppWidgets *w)
+update_unified_progress(Job *j)
 {
     /* combined ETA = dl_eta + tx_eta (whichever phase active defines numbers) */
     gdouble remain = 0.0;
-    if (w->phase == PHASE_DOWNLOADING) {
-        remain = w->dl_eta_sec + w->tx_eta_sec; /* tx may be unknown -> 0 */
-    } else if (w->phase == PHASE_TRANSCODING) {
-        remain = w->tx_eta_sec; /* download done */
+    if (j->phase == PHASE_DOWNLOADING) {
+        remain = j->dl_eta_sec + j->tx_eta_sec; /* tx may be unknown -> 0 */
+    } else if (j->phase == PHASE_DRAFTING || j->phase == PHASE_TRANSCODING) {
+        remain = j->tx_eta_sec; /* download done */
     }
 
     gint64 now_us = g_get_monotonic_time();
-    gdouble elapsed = (now_us - w->t_start_us) / 1e6;
+    gdouble elapsed = (now_us - j->t_start_us) / 1e6;
 
     gdouble est_total = elapsed + remain;
     gdouble frac = 0.0;
     if (est_total > 0.01) frac = elapsed / est_total;
     if (frac < 0.0) frac = 0.0;
     if (frac > 1.0) frac = 1.0;
-    gtk_progress_bar_set_fraction(w->progress_bar, frac);
+    gtk_progress_bar_set_fraction(j->progress_bar, frac);
 
     char etabuf[64];
     format_secs(remain, etabuf, sizeof(etabuf));
-    gtk_label_set_text(w->progress_label, etabuf);
+    gtk_label_set_text(j->progress_label, etabuf);
+}
+
+/* ---------- live preview server ---------- */
+
+static void
+preview_file_free(gpointer data)
+{
+    PreviewFile *f = data;
+    g_free(f->path);
+    g_free(f);
+}
+
+static gboolean
+preview_write(GOutputStream *out, const void *buf, gsize len)
+{
+    return g_output_stream_write_all(out, buf, len, NULL, NULL, NULL);
+}
+
+static void
+preview_reply_status(GOutputStream *out, const char *status)
+{
+    char *resp = g_strdup_printf("HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    preview_write(out, resp, strlen(resp));
+    g_free(resp);
+}
+
+/* Copy of the file/writing state for a job id; FALSE if it has no preview */
+static gboolean
+preview_lookup(PreviewServer *srv, guint id, char **path, gboolean *writing)
+{
+    g_mutex_lock(&srv->lock);
+    PreviewFile *f = g_hash_table_lookup(srv->files, GUINT_TO_POINTER(id));
+    if (f) {
+        *path = g_strdup(f->path);
+        *writing = f->writing;
+    }
+    g_mutex_unlock(&srv->lock);
+    return f != NULL;
+}
+
+/* Worth waiting for more bytes of path? Only while the encoder is still
+   appending to that same file (a draft is done once the final pass starts). */
+static gboolean
+preview_still_growing(PreviewServer *srv, guint id, const char *path)
+{
+    char *cur = NULL;
+    gboolean writing = FALSE;
+    gboolean growing = preview_lookup(srv, id, &cur, &writing) &&
+                       writing && g_strcmp0(cur, path) == 0;
+    g_free(cur);
+    return growing;
+}
+
+/* Read the request head (up to the blank line) into buf, NUL-terminated.
+   Returns its length, 0 if the client went away or timed out, or -1 if it
+   does not fit in size bytes */
+static gssize
+preview_read_head(GInputStream *in, char *buf, gsize size)
+{
+    gsize len = 0;
+    buf[0] = '\0';
+    while (len < size - 1) {
+        gssize n = g_input_stream_read(in, buf + len, size - 1 - len, NULL, NULL);
+        if (n <= 0) return 0;
+        len += (gsize)n;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) return (gssize)len;
+    }
+    return -1;
+}
+
+/* GET/HEAD /job/<id>.mp4, on a worker thread. A request from the start
+   follows the file as it grows until the encoder is done; a Range further
+   in (a player scrubbing) gets what has been written so far. */
+static gboolean
+preview_run(GThreadedSocketService *service, GSocketConnection *conn,
+            GObject *source_object, gpointer user_data)
+{
+    PreviewServer *srv = user_data;
+    GInputStream *in = g_io_stream_get_input_stream(G_IO_STREAM(conn));
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(conn));
+
+    /* a worker thread per client: don't let one that never sends (or never
+       reads) hold it forever */
+    g_socket_set_timeout(g_socket_connection_get_socket(conn), PREVIEW_TIMEOUT_SEC);
+
+    char req_head[PREVIEW_MAX_HEAD];
+    gssize head_len = preview_read_head(in, req_head, sizeof req_head);
+    char **lines = head_len > 0 ? g_strsplit(req_head, "\n", -1) : NULL;
+    guint n_lines = 0;
+    while (lines && lines[n_lines] && *g_strchomp(lines[n_lines])) /* drop the \r */
+        n_lines++;
+    if (head_len <= 0 || n_lines > PREVIEW_MAX_LINES) {
+        if (head_len != 0)
+            preview_reply_status(out, "431 Request Header Fields Too Large");
+        g_strfreev(lines);
+        g_io_stream_close(G_IO_STREAM(conn), NULL, NULL);
+        return TRUE;
+    }
+
+    char *request = g_strdup(lines[0]);
+    gint64 range_start = -1, range_end = -1;
+    for (guint i = 1; i < n_lines; i++) {
+        const char *header = lines[i];
+        if (g_ascii_strncasecmp(header, "Range: bytes=", 13) == 0) {
+            char *end = NULL;
+            range_start = g_ascii_strtoll(header + 13, &end, 10);
+            if (end && *end == '-' && g_ascii_isdigit(end[1]))
+                range_end = g_ascii_strtoll(end + 1, NULL, 10);
+        }
+    }
+    g_strfreev(lines);
+
+    /* "GET /job/3.mp4 HTTP/1.1" */
+    guint id = 0;
+    gboolean head = FALSE;
+    if (request) {
+        head = g_str_has_prefix(request, "HEAD ");
+        const char *target = strchr(request, ' ');
+        if (target && g_str_has_prefix(target + 1, "/job/"))
+            id = (guint)g_ascii_strtoull(target + 6, NULL, 10);
+    }
+    g_free(request);
+
+    char *path = NULL;
+    gboolean writing = FALSE;
+    FILE *fp = NULL;
+    if (id == 0 || !preview_lookup(srv, id, &path, &writing) || !(fp = fopen(path, "rb"))) {
+        preview_reply_status(out, "404 Not Found");
+        g_free(path);
+        g_io_stream_close(G_IO_STREAM(conn), NULL, NULL);
+        return TRUE;
+    }
+
+    struct stat st;
+    gint64 size = fstat(fileno(fp), &st) == 0 ? (gint64)st.st_size : 0;
+    gint64 remaining = -1; /* -1 = follow the file until the encoder is done */
+    gboolean follow = writing && range_start <= 0 && range_end < 0;
+
+    GString *hdr = g_string_new(NULL);
+    if (follow) {
+        g_string_append(hdr, "HTTP/1.1 200 OK\r\n");
+    } else if (range_start >= 0) {
+        if (range_start >= size) {
+            preview_reply_status(out, "416 Range Not Satisfiable");
+            g_string_free(hdr, TRUE);
+            fclose(fp);
+            g_free(path);
+            g_io_stream_close(G_IO_STREAM(conn), NULL, NULL);
+            return TRUE;
+        }
+        gint64 last = (range_end >= range_start && range_end < size) ? range_end : size - 1;
+        remaining = last - range_start + 1;
+        fseeko(fp, (off_t)range_start, SEEK_SET);
+        g_string_append_printf(hdr, "HTTP/1.1 206 Partial Content\r\n"
+                               "Content-Range: bytes %" G_GINT64_FORMAT "-%" G_GINT64_FORMAT "/",
+                               range_start, last);
+        if (writing) g_string_append(hdr, "*\r\n"); /* total not known yet */
+        else         g_string_append_printf(hdr, "%" G_GINT64_FORMAT "\r\n", size);
+        g_string_append_printf(hdr, "Content-Length: %" G_GINT64_FORMAT "\r\n", remaining);
+    } else {
+        remaining = size;
+        g_string_append_printf(hdr, "HTTP/1.1 200 OK\r\n"
+                               "Content-Length: %" G_GINT64_FORMAT "\r\n", size);
+    }
+    g_string_append(hdr, "Content-Type: video/mp4\r\n"
+                         "Accept-Ranges: bytes\r\n"
+                         "Cache-Control: no-store\r\n"
+                         "Connection: close\r\n\r\n");
+
+    gboolean ok = preview_write(out, hdr->str, hdr->len);
+    g_string_free(hdr, TRUE);
+
+    char *buf = g_malloc(PREVIEW_CHUNK);
+    gboolean finishing = FALSE;
+    while (ok && !head && remaining != 0) {
+        gsize want = PREVIEW_CHUNK;
+        if (remaining > 0 && (gint64)want > remaining) want = (gsize)remaining;
+        size_t n = fread(buf, 1, want, fp);
+        if (n > 0) {
+            ok = preview_write(out, buf, n);
+            if (remaining > 0) remaining -= n;
+            continue;
+        }
+
+        /* caught up with the encoder */
+        if (remaining > 0 || finishing) break;
+        if (preview_still_growing(srv, id, path))
+            g_usleep(PREVIEW_POLL_MS * 1000);
+        else
+            finishing = TRUE; /* one more pass for whatever was flushed last */
+        clearerr(fp);
+    }
+
+    g_free(buf);
+    fclose(fp);
+    g_free(path);
+    g_io_stream_close(G_IO_STREAM(conn), NULL, NULL);
+    return TRUE;
+}
+
+/* Bind the loopback preview server on first use */
+static PreviewServer *
+preview_server_get(AppWidgets *w, GError **error)
+{
+    if (w->preview) return w->preview;
+
+    GSocketService *service = g_threaded_socket_service_new(8);
+    GInetAddress *lo = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    GSocketAddress *addr = g_inet_socket_address_new(lo, PREVIEW_PORT);
+    GSocketAddress *bound = NULL;
+    gboolean ok = g_socket_listener_add_address(G_SOCKET_LISTENER(service), addr,
+                                                G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
+                                                NULL, &bound, error);
+    g_object_unref(addr);
+    g_object_unref(lo);
+    if (!ok) {
+        g_object_unref(service);
+        return NULL;
+    }
+
+    PreviewServer *srv = g_new0(PreviewServer, 1);
+    srv->service = service;
+    srv->port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(bound));
+    g_object_unref(bound);
+    g_mutex_init(&srv->lock);
+    srv->files = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, preview_file_free);
+
+    g_signal_connect(service, "run", G_CALLBACK(preview_run), srv);
+    g_socket_service_start(service);
+    w->preview = srv;
+    return srv;
+}
+
+/* Point the job's preview URL at the file the encoder is writing now
+   (the draft's temp file, then the final pass's partial), or at the
+   finished output once the final pass has been committed */
+static void
+preview_publish(Job *j, gboolean writing)
+{
+    PreviewServer *srv = j->app->preview;
+    if (!j->preview || !srv) return;
+
+    PreviewFile *f = g_new0(PreviewFile, 1);
+    const char *tmp = NULL;
+    if (writing)
+        tmp = j->phase == PHASE_DRAFTING ? j->preview->draft : j->preview->partial;
+    f->path = g_strdup(tmp ? tmp : j->preview->path);
+    f->writing = writing;
+
+    g_mutex_lock(&srv->lock);
+    g_hash_table_insert(srv->files, GUINT_TO_POINTER(j->id), f);
+    g_mutex_unlock(&srv->lock);
+}
+
+/* Job ended without output of its own: whatever sits at the output path
+   predates it, so the URL answers 404 from now on */
+static void
+preview_unpublish(Job *j)
+{
+    PreviewServer *srv = j->app->preview;
+    if (!j->preview || !srv) return;
+
+    g_mutex_lock(&srv->lock);
+    g_hash_table_remove(srv->files, GUINT_TO_POINTER(j->id));
+    g_mutex_unlock(&srv->lock);
+}
+
+/* ---------- scratch space ---------- */
+
+static const char *
+scratch_disk_dir(void)
+{
+    const char *dir = g_getenv("BETINHA_SCRATCH_DIR");
+    return dir && *dir ? dir : SCRATCH_DISK_DIR;
+}
+
+static gboolean
+fs_free_space(const char *dir, dev_t *dev, guint64 *avail, GError **error)
+{
+    struct stat st;
+    struct statvfs vfs;
+    if (stat(dir, &st) != 0 || statvfs(dir, &vfs) != 0) {
+        int err = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                    "Cannot check free space in '%s': %s", dir, g_strerror(err));
+        return FALSE;
+    }
+    *dev = st.st_dev;
+    *avail = (guint64)vfs.f_bavail * vfs.f_frsize;
+    return TRUE;
+}
+
+static void
+scratch_remove_tree(const char *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (dir) {
+        const char *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            char *child = g_build_filename(path, name, NULL);
+            if (g_file_test(child, G_FILE_TEST_IS_DIR) &&
+                !g_file_test(child, G_FILE_TEST_IS_SYMLINK))
+                scratch_remove_tree(child);
+            else
+                unlink(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+    rmdir(path);
+}
+
+/* Temp outputs live next to the outputs, anywhere on disk, so each run
+   lists them in a manifest in the scratch dir for the cleanup below */
+static char *
+scratch_manifest_path(int pid)
+{
+    char *name = g_strdup_printf(SCRATCH_PREFIX "%d" SCRATCH_MANIFEST_EXT, pid);
+    char *path = g_build_filename(scratch_disk_dir(), name, NULL);
+    g_free(name);
+    return path;
+}
+
+static void
+scratch_track_temp(const char *path)
+{
+    char *manifest = scratch_manifest_path((int)getpid());
+    FILE *fp = fopen(manifest, "a");
+    if (fp) {
+        fprintf(fp, "%s\n", path);
+        fclose(fp);
+    }
+    g_free(manifest);
+}
+
+/* Delete the temp outputs a manifest lists (only names carrying that run's
+   pid tag, whatever else the file says), then the manifest itself */
+static void
+scratch_remove_listed(const char *manifest, gint64 pid)
+{
+    char *contents = NULL;
+    if (g_file_get_contents(manifest, &contents, NULL, NULL)) {
+        char *tag = g_strdup_printf("." SCRATCH_PREFIX "%" G_GINT64_FORMAT ".", pid);
+        char **lines = g_strsplit(contents, "\n", -1);
+        for (guint i = 0; lines[i]; i++) {
+            char *base = g_path_get_basename(lines[i]);
+            if (base[0] == '.' && strstr(base, tag))
+                unlink(lines[i]);
+            g_free(base);
+        }
+        g_strfreev(lines);
+        g_free(tag);
+        g_free(contents);
+    }
+    unlink(manifest);
+}
+
+/* Our own manifest on a clean exit: dropped once everything it lists has
+   been committed or removed, otherwise the next run cleans up after us */
+static void
+scratch_manifest_done(void)
+{
+    char *manifest = scratch_manifest_path((int)getpid());
+    char *contents = NULL;
+    gboolean pending = FALSE;
+    if (g_file_get_contents(manifest, &contents, NULL, NULL)) {
+        char **lines = g_strsplit(contents, "\n", -1);
+        for (guint i = 0; lines[i] && !pending; i++)
+            pending = *lines[i] && g_file_test(lines[i], G_FILE_TEST_EXISTS);
+        g_strfreev(lines);
+        g_free(contents);
+        if (!pending) unlink(manifest);
+    }
+    g_free(manifest);
+}
+
+typedef enum {
+    SCRATCH_ENTRY_NONE = 0,
+    SCRATCH_ENTRY_WORKSPACE,   /* betinha-<pid>-XXXXXX/ (see scratch_mkdtemp) */
+    SCRATCH_ENTRY_MANIFEST     /* betinha-<pid>.partials */
+} ScratchEntry;
+
+static gsize
+scratch_digits(const char *s)
+{
+    gsize n = 0;
+    while (g_ascii_isdigit(s[n])) n++;
+    return n;
+}
+
+/* Which of our own names is this, if any? Anything else in the scratch
+   dirs (a "betinha-2" checkout, a "betinha-1.2" unpack...) is not ours. */
+static ScratchEntry
+scratch_parse_name(const char *name, gint64 *pid)
+{
+    if (!g_str_has_prefix(name, SCRATCH_PREFIX)) return SCRATCH_ENTRY_NONE;
+    const char *p = name + strlen(SCRATCH_PREFIX);
+    gsize n = scratch_digits(p);
+    if (n == 0 || n > 9) return SCRATCH_ENTRY_NONE;
+    *pid = g_ascii_strtoll(p, NULL, 10);
+    if (*pid <= 0) return SCRATCH_ENTRY_NONE;
+    p += n;
+
+    if (strcmp(p, SCRATCH_MANIFEST_EXT) == 0) return SCRATCH_ENTRY_MANIFEST;
+    if (*p++ != '-') return SCRATCH_ENTRY_NONE;
+    for (n = 0; n < 6; n++)
+        if (!g_ascii_isalnum(p[n])) return SCRATCH_ENTRY_NONE;
+    return p[6] == '\0' ? SCRATCH_ENTRY_WORKSPACE : SCRATCH_ENTRY_NONE;
+}
+
+/* Remove workspaces and temp outputs left behind by runs that are no
+   longer alive */
+static void
+scratch_cleanup_stale(void)
+{
+    const char *roots[] = { SCRATCH_TMPFS_DIR, scratch_disk_dir(), NULL };
+    for (int r = 0; roots[r]; r++) {
+        GDir *dir = g_dir_open(roots[r], 0, NULL);
+        if (!dir) continue;
+        const char *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            gint64 pid = 0;
+            ScratchEntry kind = scratch_parse_name(name, &pid);
+            if (kind == SCRATCH_ENTRY_NONE || pid == getpid()) continue;
+            if (kill((pid_t)pid, 0) == 0 || errno != ESRCH) continue;
+
+            /* and only of the type we create, never through a symlink */
+            char *path = g_build_filename(roots[r], name, NULL);
+            struct stat st;
+            if (lstat(path, &st) == 0) {
+                if (kind == SCRATCH_ENTRY_WORKSPACE && S_ISDIR(st.st_mode))
+                    scratch_remove_tree(path);
+                else if (kind == SCRATCH_ENTRY_MANIFEST && S_ISREG(st.st_mode))
+                    scratch_remove_listed(path, pid);
+            }
+            g_free(path);
+        }
+        g_dir_close(dir);
+    }
+}
+
+/* New private workspace under root. The scratch roots are shared and
+   world-writable, so the name must not be guessable and the directory
+   must not already exist: mkdtemp creates it 0700 or fails. */
+static char *
+scratch_mkdtemp(const char *root, GError **error)
+{
+    char *name = g_strdup_printf(SCRATCH_PREFIX "%d-XXXXXX", (int)getpid());
+    char *dir = g_build_filename(root, name, NULL);
+    g_free(name);
+    if (!g_mkdtemp_full(dir, 0700)) {
+        int err = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                    "Failed to create a workspace in '%s': %s", root, g_strerror(err));
+        g_free(dir);
+        return NULL;
+    }
+    return dir;
+}
+
+/* Disk blocks used by path (recursively for a directory) */
+static guint64
+scratch_usage(const char *path)
+{
+    struct stat st;
+    if (!path || lstat(path, &st) != 0) return 0;
+    guint64 sum = (guint64)st.st_blocks * 512;
+    if (S_ISDIR(st.st_mode)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        if (dir) {
+            const char *name;
+            while ((name = g_dir_read_name(dir)) != NULL) {
+                char *child = g_build_filename(path, name, NULL);
+                sum += scratch_usage(child);
+                g_free(child);
+            }
+            g_dir_close(dir);
+        }
+    }
+    return sum;
+}
+
+static guint64
+scratch_unwritten(guint64 reserved, guint64 used)
+{
+    return used < reserved ? reserved - used : 0;
+}
+
+/* Space admitted jobs (other than self) may still take on filesystem dev.
+   What they already wrote is gone from the free space statvfs reports, so
+   only the rest of each reservation counts. */
+static guint64
+scratch_reserved_on(AppWidgets *w, Job *self, dev_t dev)
+{
+    guint64 sum = 0;
+    for (guint i = 0; i < w->jobs->len; i++) {
+        Job *j = w->jobs->pdata[i];
+        if (j == self || !j->active) continue;
+        if (j->scratch_bytes && j->scratch_dev == dev)
+            sum += scratch_unwritten(j->scratch_bytes, scratch_usage(j->scratch_dir));
+        if (j->out_bytes && j->out_dev == dev) {
+            guint64 used = 0;
+            for (guint k = 0; k < j->outputs->len; k++) {
+                OutputSpec *o = j->outputs->pdata[k];
+                used += scratch_usage(o->partial) + scratch_usage(o->draft);
+            }
+            sum += scratch_unwritten(j->out_bytes, used);
+        }
+    }
+    return sum;
+}
+
+static gboolean
+scratch_others_admitted(AppWidgets *w, Job *self)
+{
+    for (guint i = 0; i < w->jobs->len; i++) {
+        Job *j = w->jobs->pdata[i];
+        if (j != self && j->active && (j->scratch_bytes || j->out_bytes)) return TRUE;
+    }
+    return FALSE;
+}
+
+/* Rough size of what j writes next to its outputs: a video output can be
+   as big as the source, audio about a tenth, images are small, and a
+   draft sits next to the final partial until the rename */
+static guint64
+estimate_output_bytes(Job *j, guint64 in_bytes)
+{
+    guint64 total = 0;
+    for (guint i = 0; i < j->outputs->len; i++) {
+        OutputSpec *o = j->outputs->pdata[i];
+        if (is_image_format(o->format))      total += (guint64)16 << 20;
+        else if (is_audio_format(o->format)) total += in_bytes / 10;
+        else if (j->draft_mode)              total += in_bytes + in_bytes / 4;
+        else                                 total += in_bytes;
+    }
+    return total;
+}
+
+/* Doesn't fit: worth waiting only while other jobs hold reservations */
+static gboolean
+scratch_no_space(Job *j, const char *dir, guint64 need, GError **error)
+{
+    if (scratch_others_admitted(j->app, j)) return FALSE;
+    char *size = g_format_size(need + SCRATCH_MARGIN);
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOSPC,
+                "Not enough free space in '%s' (needs about %s).", dir, size);
+    g_free(size);
+    return FALSE;
+}
+
+/* Admission control. Places the download workspace (tmpfs for small jobs,
+   the scratch disk otherwise) and checks that it and the outputs fit next
+   to what running jobs have reserved. TRUE = admitted, reservations
+   recorded; FALSE with error = can't fit; FALSE without = try again when
+   another job ends. */
+static gboolean
+scratch_admit(Job *j, GError **error)
+{
+    AppWidgets *w = j->app;
+    guint64 in_bytes = j->expected_bytes ? j->expected_bytes : SCRATCH_DEFAULT_SIZE;
+    guint64 out_need = estimate_output_bytes(j, in_bytes);
+    guint64 dl_need = j->url ? in_bytes * 2 : 0; /* video + audio parts, then the merged file */
+
+    char *out_dir = g_path_get_dirname(((OutputSpec *)j->outputs->pdata[0])->path);
+    dev_t out_dev = 0;
+    guint64 out_free = 0;
+    if (!fs_free_space(out_dir, &out_dev, &out_free, error)) {
+        g_free(out_dir);
+        return FALSE;
+    }
+
+    const char *root = NULL;
+    dev_t dl_dev = 0;
+    if (dl_need > 0) {
+        const char *roots[] = {
+            dl_need <= SCRATCH_TMPFS_MAX ? SCRATCH_TMPFS_DIR : NULL,
+            scratch_disk_dir()
+        };
+        for (int i = 0; i < 2 && !root; i++) {
+            dev_t dev;
+            guint64 avail;
+            if (!roots[i] || !fs_free_space(roots[i], &dev, &avail, NULL)) continue;
+            guint64 need = dl_need + (dev == out_dev ? out_need : 0);
+            if (avail >= scratch_reserved_on(w, j, dev) + need + SCRATCH_MARGIN) {
+                root = roots[i];
+                dl_dev = dev;
+            }
+        }
+        if (!root) {
+            g_free(out_dir);
+            return scratch_no_space(j, scratch_disk_dir(), dl_need, error);
+        }
+    }
+
+    guint64 out_total = out_need + (root && dl_dev == out_dev ? dl_need : 0);
+    if (out_free < scratch_reserved_on(w, j, out_dev) + out_total + SCRATCH_MARGIN) {
+        gboolean ok = scratch_no_space(j, out_dir, out_total, error);
+        g_free(out_dir);
+        return ok;
+    }
+    g_free(out_dir);
+
+    if (root) {
+        char *dir = scratch_mkdtemp(root, error);
+        if (!dir) return FALSE;
+        j->scratch_dir = dir;
+        j->scratch_bytes = dl_need;
+        j->scratch_dev = dl_dev;
+        g_free(j->input_path);
+        j->input_path = g_build_filename(dir, "input.mkv", NULL);
+    }
+    j->out_bytes = out_need;
+    j->out_dev = out_dev;
+    return TRUE;
+}
+
+static void
+scratch_release(Job *j)
+{
+    if (j->scratch_dir) {
+        scratch_remove_tree(j->scratch_dir);
+        g_clear_pointer(&j->scratch_dir, g_free);
+    }
+    if (j->probe_dir) {
+        scratch_remove_tree(j->probe_dir);
+        g_clear_pointer(&j->probe_dir, g_free);
+    }
+    g_clear_pointer(&j->info_json, g_free);
+    j->scratch_bytes = 0;
+    j->out_bytes = 0;
+}
+
+/* ---------- jobs ---------- */
+
+/* Add a job (and its row in the jobs list) for the current form values */
+static void on_job_cancel_clicked(GtkButton *btn, gpointer user_data); /* fwd decl */
+
+static Job *
+job_new(AppWidgets *w, const char *input, GPtrArray *outputs)
+{
+    Job *j = g_new0(Job, 1);
+    j->app = w;
+    j->id = ++w->next_job_id;
+    j->outputs = outputs;
+    j->draft_mode = gtk_check_button_get_active(w->draft_check);
+    j->priority = gtk_spin_button_get_value_as_int(w->priority_spin);
+    j->active = TRUE;
+
+    /* every output is written to a partial (and its draft to a temp file of
+       its own) and renamed into place when done */
+    for (guint i = 0; i < outputs->len; i++) {
+        OutputSpec *o = outputs->pdata[i];
+        o->partial = make_temp_path(o->path, "part");
+        scratch_track_temp(o->partial);
+        if (j->draft_mode && !is_audio_format(o->format) && !is_image_format(o->format)) {
+            o->draft = make_temp_path(o->path, "draft");
+            scratch_track_temp(o->draft);
+        }
+    }
+
+    /* downloads get their input path in a workspace once admitted */
+    if (is_youtube_url(input))
+        j->url = g_strdup(input);
+    else
+        j->input_path = g_strdup(input);
+
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+    char *name = g_path_get_basename(((OutputSpec *)outputs->pdata[0])->path);
+    char *title = outputs->len > 1
+        ? g_strdup_printf("#%u  %s (+%u more)", j->id, name, outputs->len - 1)
+        : g_strdup_printf("#%u  %s", j->id, name);
+    GtkWidget *title_label = gtk_label_new(title);
+    gtk_label_set_xalign(GTK_LABEL(title_label), 0.0);
+    gtk_box_append(GTK_BOX(row), title_label);
+    g_free(title);
+    g_free(name);
+
+    j->progress_bar = GTK_PROGRESS_BAR(gtk_progress_bar_new());
+    gtk_progress_bar_set_show_text(j->progress_bar, TRUE);
+    gtk_box_append(GTK_BOX(row), GTK_WIDGET(j->progress_bar));
+
+    GtkWidget *info_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    j->progress_label = GTK_LABEL(gtk_label_new("00:00:00"));
+    j->status_label = GTK_LABEL(gtk_label_new(""));
+    gtk_label_set_xalign(j->status_label, 0.0);
+    gtk_widget_set_hexpand(GTK_WIDGET(j->status_label), TRUE);
+    gtk_box_append(GTK_BOX(info_row), GTK_WIDGET(j->progress_label));
+    gtk_box_append(GTK_BOX(info_row), GTK_WIDGET(j->status_label));
+    j->cancel_btn = GTK_BUTTON(gtk_button_new_with_label("Cancel"));
+    gtk_box_append(GTK_BOX(info_row), GTK_WIDGET(j->cancel_btn));
+    g_signal_connect(j->cancel_btn, "clicked", G_CALLBACK(on_job_cancel_clicked), j);
+    gtk_box_append(GTK_BOX(row), info_row);
+
+    if (gtk_check_button_get_active(w->live_check)) {
+        for (guint i = 0; i < outputs->len; i++) {
+            OutputSpec *o = outputs->pdata[i];
+            if (g_strcmp0(o->format, "MP4") != 0) continue;
+            o->fragmented = TRUE;
+            if (!j->preview) j->preview = o;
+        }
+
+        GError *err = NULL;
+        PreviewServer *srv = j->preview ? preview_server_get(w, &err) : NULL;
+        if (srv) {
+            char *url = g_strdup_printf("Preview: http://127.0.0.1:%u/job/%u.mp4",
+                                        (guint)srv->port, j->id);
+            j->preview_label = GTK_LABEL(gtk_label_new(url));
+            gtk_label_set_selectable(j->preview_label, TRUE);
+            gtk_label_set_xalign(j->preview_label, 0.0);
+            gtk_box_append(GTK_BOX(row), GTK_WIDGET(j->preview_label));
+            g_free(url);
+        } else if (err) {
+            gtk_label_set_text(j->status_label, err->message);
+            g_error_free(err);
+            j->preview = NULL;
+        }
+    }
+
+    gtk_list_box_append(w->jobs_list, row);
+    g_ptr_array_add(w->jobs, j);
+    return j;
+}
+
+static void dl_sched_kick(AppWidgets *w); /* fwd decl */
+
+/* Job reached a terminal state: show status (NULL keeps the current one,
+   e.g. a spawn error), drop its workspace and give its space back */
+static void
+job_finish(Job *j, const char *status)
+{
+    if (status) gtk_label_set_text(j->status_label, status);
+    j->active = FALSE;
+    j->phase = PHASE_IDLE;
+    gtk_widget_set_sensitive(GTK_WIDGET(j->cancel_btn), FALSE);
+    preview_unpublish(j);
+    scratch_release(j);
+    dl_sched_kick(j->app);
 }
 
 /* ---------- yt-dlp (download) ---------- */
@@ -186,7 +1337,7 @@ update_unified_progress(AppWidgets *w)
 static gboolean
 ytdlp_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
 {
-    AppWidgets *w = data;
+    Job *j = data;
     if (cond & (G_IO_HUP | G_IO_ERR)) return FALSE;
 
     gchar *line = NULL;
@@ -200,7 +1351,7 @@ ytdlp_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
         */
         if (g_str_has_prefix(line, "progress:[")) {
             /* crude parse */
-            gdouble eta = 0.0;
+            gdouble eta = 0.0, speed = 0.0;
             gdouble downloaded = 0.0, total = 0.0;
             char *p = line;
             /* look for tokens */
@@ -212,185 +1363,444 @@ ytdlp_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
             if (tok) total = g_ascii_strtod(tok + 6, NULL);
             tok = g_strstr_len(p, len, "eta=");
             if (tok) eta = g_ascii_strtod(tok + 4, NULL);
+            tok = g_strstr_len(p, len, "speed=");
+            if (tok) speed = g_ascii_strtod(tok + 6, NULL);
+
+            j->dl_eta_sec = eta > 0 ? eta : 0.0;
+
+            /* feed the download scheduler: bytes drain the job's bucket,
+               speed tells it whether the job is using its whole share */
+            j->dl_bytes = downloaded;
+            j->dl_speed = speed > 0 ? speed : 0.0;
+
+            /* if we have total, we can compute per-phase fraction (not used for bar directly) */
+            if (total > 0) {
+                j->dl_progress_0_1 = downloaded / total;
+                if (j->dl_progress_0_1 < 0) j->dl_progress_0_1 = 0;
+                if (j->dl_progress_0_1 > 1) j->dl_progress_0_1 = 1;
+            }
+
+            update_unified_progress(j);
+        }
+        g_free(line);
+        return TRUE;
+    }
+
+    if (st == G_IO_STATUS_EOF) {
+        if (line) g_free(line);
+        return FALSE;
+    }
+
+    if (err) g_error_free(err);
+    return TRUE;
+}
+
+static gboolean start_transcode(Job *j); /* fwd decl */
+static void dl_sched_done(Job *j);        /* fwd decl */
+
+static void
+child_watch_ytdlp(GPid pid, gint status, gpointer user_data)
+{
+    Job *j = user_data;
+
+    if (j->yt_io) {
+        g_io_channel_shutdown(j->yt_io, FALSE, NULL);
+        g_io_channel_unref(j->yt_io);
+        j->yt_io = NULL;
+    }
+    g_spawn_close_pid(pid);
+    j->yt_pid = 0;
+    dl_sched_done(j);
+
+    if (j->cancel_requested) {
+        gtk_progress_bar_set_fraction(j->progress_bar, 0.0);
+        job_finish(j, "Canceled.");
+        return;
+    }
+
+    if (!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+        job_finish(j, "Download failed.");
+        return;
+    }
+
+    /* move to transcoding */
+    gtk_label_set_text(j->status_label, "Download finished. Starting conversion…");
+
+    /* get duration of the downloaded file for ffmpeg ETA; the draft and
+       final encodes both reuse this input and probe */
+    j->total_duration = get_media_duration(j->input_path);
+
+    /* output paths were already prepared when the job was submitted */
+    if (start_transcode(j)) {
+        /* immediate progress recompute */
+        update_unified_progress(j);
+    } else {
+        job_finish(j, NULL);
+    }
+}
+
+/* own process group, so the scheduler can pause yt-dlp and any helper it spawns */
+static void
+ytdlp_child_setup(gpointer user_data)
+{
+    setpgid(0, 0);
+}
+
+/* Build args and start yt-dlp (relative path), capture stdout for progress */
+static gboolean
+start_ytdlp(Job *j)
+{
+    /* reset unified model */
+    j->phase = PHASE_DOWNLOADING;
+    j->dl_eta_sec = 0;
+    j->tx_eta_sec = 0;
+    j->dl_progress_0_1 = 0;
+    j->tx_progress_0_1 = 0;
+    j->t_start_us = g_get_monotonic_time();
 
-            w->dl_eta_sec = eta > 0 ? eta : 0.0;
+    /* reuse the probe's extraction instead of asking YouTube again */
+    gboolean have_info = j->info_json && g_file_test(j->info_json, G_FILE_TEST_IS_REGULAR);
 
-            /* if we have total, we can compute per-phase fraction (not used for bar directly) */
-            if (total > 0) {
-                w->dl_progress_0_1 = downloaded / total;
-                if (w->dl_progress_0_1 < 0) w->dl_progress_0_1 = 0;
-                if (w->dl_progress_0_1 > 1) w->dl_progress_0_1 = 1;
-            }
+    /* We force final container to mkv so we know the file path */
+    gchar *argv[] = {
+        (gchar *)PYTHON_PROG, (gchar *)YTDLP_PATH,
+        "--newline",
+        "-f", "bv*+ba/b",
+        "--merge-output-format", "mkv",
+        "-o", j->input_path,
+        "--progress-template",
+        "progress:[downloaded=%(progress.downloaded_bytes)s total=%(progress.total_bytes)s eta=%(progress.eta)s speed=%(progress.speed)s percent=%(progress._percent_str)s]",
+        have_info ? "--load-info-json" : j->url,
+        have_info ? j->info_json : NULL,
+        NULL
+    };
 
-            update_unified_progress(w);
-        }
-        g_free(line);
-        return TRUE;
-    }
+    GError *err = NULL;
+    gint stdout_fd = -1;
 
-    if (st == G_IO_STATUS_EOF) {
-        if (line) g_free(line);
+    gboolean ok = g_spawn_async_with_pipes(
+        NULL, argv, NULL,
+        G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+        ytdlp_child_setup, NULL,
+        &j->yt_pid,
+        NULL, &stdout_fd, NULL,
+        &err
+    );
+
+    if (!ok) {
+        gtk_label_set_text(j->status_label, err->message);
+        g_error_free(err);
+        j->yt_pid = 0;
         return FALSE;
     }
 
-    if (err) g_error_free(err);
+    gtk_label_set_text(j->status_label, "Downloading from YouTube…");
+
+    j->yt_io = g_io_channel_unix_new(stdout_fd);
+    g_io_channel_set_encoding(j->yt_io, NULL, NULL);
+    g_io_channel_set_buffered(j->yt_io, TRUE);
+    g_io_add_watch(j->yt_io, G_IO_IN | G_IO_HUP | G_IO_ERR, ytdlp_progress_cb, j);
+
+    g_child_watch_add(j->yt_pid, child_watch_ytdlp, j);
     return TRUE;
 }
 
-static void child_watch_ffmpeg(GPid pid, gint status, gpointer user_data); /* fwd decl */
+/* ---------- download scheduler ---------- */
+
+/* Each running download gets a share of the global cap proportional to
+   its priority and is kept inside it with a token bucket: the bytes that
+   ytdlp_progress_cb reports drain the bucket, and a job that runs dry is
+   SIGSTOPped until its share refills it. TCP flow control then slows the
+   sender, so the link is actually left to the other jobs. */
 
 static void
-child_watch_ytdlp(GPid pid, gint status, gpointer user_data)
+dl_sched_set_paused(Job *j, gboolean paused)
 {
-    AppWidgets *w = user_data;
+    if (j->dl_paused == paused || j->yt_pid == 0) return;
+    kill(-j->yt_pid, paused ? SIGSTOP : SIGCONT);
+    j->dl_paused = paused;
+}
 
-    if (w->yt_io) {
-        g_io_channel_shutdown(w->yt_io, FALSE, NULL);
-        g_io_channel_unref(w->yt_io);
-        w->yt_io = NULL;
+/* Weighted max-min split of cap: a job whose bucket stayed full is not
+   using its share, so it is held a little above its reported speed and
+   the rest goes to the others. Once it wants more it drains its bucket
+   and gets its full weighted share back on the next tick. */
+static void
+dl_sched_rebalance(AppWidgets *w, gdouble cap)
+{
+    guint n = w->dl_running->len;
+    gboolean *fixed = g_new0(gboolean, n);
+    gdouble remaining = cap;
+    gdouble weight = 0;
+
+    /* probes hold a slot but download nothing */
+    for (guint i = 0; i < n; i++) {
+        Job *j = w->dl_running->pdata[i];
+        if (j->yt_pid) weight += j->priority;
+        else fixed[i] = TRUE;
     }
-    g_spawn_close_pid(pid);
-    w->yt_pid = 0;
 
-    if (w->cancel_requested) {
-        gtk_label_set_text(w->status_label, "Canceled.");
-        gtk_progress_bar_set_fraction(w->progress_bar, 0.0);
-        return;
+    gboolean changed = TRUE;
+    while (changed && weight > 0) {
+        changed = FALSE;
+        for (guint i = 0; i < n; i++) {
+            Job *j = w->dl_running->pdata[i];
+            if (fixed[i]) continue;
+            gdouble fair = remaining * j->priority / weight;
+            gboolean bucket_full = j->dl_share_bps > 0 &&
+                                   j->dl_credit >= j->dl_share_bps * DL_BURST_SEC * 0.99;
+            if (!j->dl_paused && bucket_full && j->dl_speed > 0 && j->dl_speed * 1.25 < fair) {
+                j->dl_share_bps = j->dl_speed * 1.25;
+                remaining -= j->dl_share_bps;
+                weight -= j->priority;
+                fixed[i] = TRUE;
+                changed = TRUE;
+            }
+        }
     }
 
-    if (!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
-        gtk_label_set_text(w->status_label, "Download failed.");
-        return;
+    for (guint i = 0; i < n; i++) {
+        Job *j = w->dl_running->pdata[i];
+        if (!fixed[i])
+            j->dl_share_bps = weight > 0 ? remaining * j->priority / weight : 0;
     }
+    g_free(fixed);
+}
 
-    /* move to transcoding */
-    gtk_label_set_text(w->status_label, "Download finished. Starting conversion…");
-    w->phase = PHASE_TRANSCODING;
+static gboolean
+dl_sched_tick(gpointer user_data)
+{
+    AppWidgets *w = user_data;
 
-    /* get duration of the downloaded file for ffmpeg ETA */
-    w->total_duration = get_media_duration(YTDLP_TMP_FILE);
+    if (w->dl_running->len == 0) {
+        w->dl_tick_id = 0;
+        return G_SOURCE_REMOVE;
+    }
 
-    /* start ffmpeg with progress on stderr */
-    const char *output_raw = gtk_editable_get_text(GTK_EDITABLE(w->output_entry));
-    guint sel = gtk_drop_down_get_selected(w->format_dropdown);
-    GtkStringList *slist = GTK_STRING_LIST(gtk_drop_down_get_model(w->format_dropdown));
-    const char *fmt = gtk_string_list_get_string(slist, sel);
-    char *output = append_extension_if_missing(output_raw, fmt);
+    gint64 now_us = g_get_monotonic_time();
+    gdouble dt = (now_us - w->dl_tick_us) / 1e6;
+    w->dl_tick_us = now_us;
+
+    /* read every tick so a new cap applies to running downloads */
+    gdouble cap = gtk_spin_button_get_value(w->bw_cap_spin) * 1024.0;
+    if (cap > 0) dl_sched_rebalance(w, cap);
+
+    for (guint i = 0; i < w->dl_running->len; i++) {
+        Job *j = w->dl_running->pdata[i];
+        if (!j->yt_pid) continue; /* still probing */
+
+        gdouble used = j->dl_bytes - j->dl_bytes_tick;
+        if (used < 0) used = j->dl_bytes; /* next file (e.g. audio after video) */
+        j->dl_bytes_tick = j->dl_bytes;
+
+        if (cap <= 0) {
+            j->dl_share_bps = 0;
+            j->dl_credit = 0;
+            dl_sched_set_paused(j, FALSE);
+            continue;
+        }
 
-    GError *err = NULL;
-    if (!ensure_output_path(output, &err)) {
-        gtk_label_set_text(w->status_label, err->message);
-        g_error_free(err);
-        g_free(output);
-        return;
+        j->dl_credit += j->dl_share_bps * dt - used;
+        if (j->dl_credit > j->dl_share_bps * DL_BURST_SEC)
+            j->dl_credit = j->dl_share_bps * DL_BURST_SEC;
+        dl_sched_set_paused(j, j->dl_credit < 0);
     }
+    return G_SOURCE_CONTINUE;
+}
 
-    gchar *argv[] = {
-        "ffmpeg",
-        "-y",
-        "-i", (gchar *)YTDLP_TMP_FILE,
-        "-progress", "pipe:2",       /* key=value machine lines on stderr */
-        "-nostats",                  /* we rely on -progress */
-        (gchar *)output,
+static void start_local_job(Job *j); /* fwd decl */
+static void ytdlp_probe_done(GObject *source, GAsyncResult *res, gpointer user_data);
+
+/* Ask yt-dlp for the expected size first, so the job can be admitted
+   before anything is downloaded. The extraction is kept as an info JSON
+   in a private workspace, and the download loads it instead of redoing it. */
+static gboolean
+dl_sched_probe(Job *j)
+{
+    j->probe_dir = scratch_mkdtemp(scratch_disk_dir(), NULL);
+    if (!j->probe_dir) return FALSE;
+    /* yt-dlp turns this into <probe_dir>/probe.info.json */
+    char *tmpl = g_strconcat("infojson:", j->probe_dir, G_DIR_SEPARATOR_S "probe.%(ext)s", NULL);
+
+    const gchar *argv[] = {
+        PYTHON_PROG, YTDLP_PATH,
+        "--no-warnings", "--no-playlist",
+        "--no-simulate", "--skip-download", /* --print alone would skip the info JSON */
+        "-f", "bv*+ba/b",
+        "--write-info-json", "-o", tmpl,
+        "--print", "%(filesize,filesize_approx)s",
+        j->url,
         NULL
     };
 
-    gint stderr_fd = -1;
-    gboolean ok = g_spawn_async_with_pipes(
-        NULL, argv, NULL,
-        G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
-        NULL, NULL,
-        &w->ffmpeg_pid,
-        NULL, NULL, &stderr_fd, &err);
-
-    if (!ok) {
-        gtk_label_set_text(w->status_label, err->message);
+    GError *err = NULL;
+    j->probe = g_subprocess_newv(argv,
+        G_SUBPROCESS_FLAGS_STDOUT_PIPE | G_SUBPROCESS_FLAGS_STDERR_SILENCE, &err);
+    g_free(tmpl);
+    if (!j->probe) {
         g_error_free(err);
-        g_free(output);
-        w->ffmpeg_pid = 0;
-        return;
+        scratch_remove_tree(j->probe_dir);
+        g_clear_pointer(&j->probe_dir, g_free);
+        return FALSE;
     }
 
-    w->ff_io = g_io_channel_unix_new(stderr_fd);
-    g_io_channel_set_encoding(w->ff_io, NULL, NULL);
-    g_io_channel_set_buffered(w->ff_io, TRUE);
-    g_io_add_watch(w->ff_io, G_IO_IN | G_IO_HUP | G_IO_ERR, (GIOFunc) ytdlp_progress_cb /* placeholder */, NULL); /* will replace */
+    j->info_json = g_build_filename(j->probe_dir, "probe.info.json", NULL);
+    gtk_label_set_text(j->status_label, "Checking size…");
+    g_subprocess_communicate_utf8_async(j->probe, NULL, NULL, ytdlp_probe_done, j);
+    return TRUE;
+}
+
+/* Start local jobs that now fit on disk, then queued downloads (highest
+   priority first) while there is room; jobs that don't fit on disk yet
+   stay queued, smaller ones may pass */
+static void
+dl_sched_pump(AppWidgets *w)
+{
+    guint k = 0;
+    while (k < w->local_waiting->len) {
+        Job *j = w->local_waiting->pdata[k];
+
+        GError *err = NULL;
+        if (!scratch_admit(j, &err)) {
+            if (err) {
+                g_ptr_array_remove_index(w->local_waiting, k);
+                job_finish(j, err->message);
+                g_error_free(err);
+            } else {
+                k++;
+            }
+            continue;
+        }
+
+        g_ptr_array_remove_index(w->local_waiting, k);
+        start_local_job(j);
+    }
 
-    /* replace with proper ffmpeg progress cb */
-    g_source_remove_by_user_data(NULL); /* no-op silencer */
+    guint i = 0;
+    while (w->dl_running->len < DL_MAX_CONCURRENT && i < w->dl_waiting->len) {
+        Job *j = w->dl_waiting->pdata[i];
 
-    /* add correct watch */
-    g_io_add_watch(w->ff_io, G_IO_IN | G_IO_HUP | G_IO_ERR, (GIOFunc)
-        /* inline adapter that calls our ffmpeg cb below */
-        (gpointer)NULL, NULL);
+        if (!j->probed) {
+            g_ptr_array_remove_index(w->dl_waiting, i);
+            if (dl_sched_probe(j)) {
+                g_ptr_array_add(w->dl_running, j);
+                continue;
+            }
+            /* not fatal: admit it with the default size estimate */
+            j->probed = TRUE;
+            g_ptr_array_insert(w->dl_waiting, i, j);
+        }
 
-    /* actually use our ffmpeg cb via separate add below */
-    /* (gtk/glib requires separate function; see registration further down) */
+        GError *err = NULL;
+        if (!scratch_admit(j, &err)) {
+            if (err) {
+                g_ptr_array_remove_index(w->dl_waiting, i);
+                job_finish(j, err->message);
+                g_error_free(err);
+            } else {
+                gtk_label_set_text(j->status_label, "Waiting for free disk space…");
+                i++;
+            }
+            continue;
+        }
 
-    g_child_watch_add(w->ffmpeg_pid, child_watch_ffmpeg, w);
+        g_ptr_array_remove_index(w->dl_waiting, i);
+        j->dl_paused = FALSE;
+        j->dl_bytes = j->dl_bytes_tick = 0;
+        j->dl_speed = 0;
+        j->dl_credit = 0;
+        j->dl_share_bps = 0;
+        if (!start_ytdlp(j)) {
+            job_finish(j, NULL);
+            continue;
+        }
+        g_ptr_array_add(w->dl_running, j);
+    }
 
-    /* immediate progress recompute */
-    update_unified_progress(w);
+    if (w->dl_running->len > 0 && w->dl_tick_id == 0) {
+        w->dl_tick_us = g_get_monotonic_time();
+        w->dl_tick_id = g_timeout_add(DL_TICK_MS, dl_sched_tick, w);
+    }
+}
 
-    g_free(output);
+static gboolean
+dl_sched_pump_idle(gpointer user_data)
+{
+    AppWidgets *w = user_data;
+    w->dl_pump_id = 0;
+    dl_sched_pump(w);
+    return G_SOURCE_REMOVE;
 }
 
-/* Build args and start yt-dlp (relative path), capture stdout for progress */
+/* A job ended and gave its space back: retry the queues from the main
+   loop (job_finish can be reached from inside dl_sched_pump itself) */
 static void
-start_ytdlp(AppWidgets *w, const char *url, const char *output)
+dl_sched_kick(AppWidgets *w)
 {
-    /* reset unified model */
-    w->phase = PHASE_DOWNLOADING;
-    w->dl_eta_sec = 0;
-    w->tx_eta_sec = 0;
-    w->dl_progress_0_1 = 0;
-    w->tx_progress_0_1 = 0;
-    w->cancel_requested = FALSE;
-    w->t_start_us = g_get_monotonic_time();
+    if (w->dl_pump_id == 0 && (w->dl_waiting->len > 0 || w->local_waiting->len > 0))
+        w->dl_pump_id = g_idle_add(dl_sched_pump_idle, w);
+}
 
-    /* ensure any old temp file is gone */
-    unlink(YTDLP_TMP_FILE);
+/* Insert by priority; a probed job goes ahead of unprobed ones of the
+   same priority, so it isn't starved by the probes it lets through */
+static void
+dl_sched_enqueue(Job *j)
+{
+    AppWidgets *w = j->app;
+
+    guint pos = 0;
+    while (pos < w->dl_waiting->len) {
+        Job *q = w->dl_waiting->pdata[pos];
+        if (q->priority < j->priority ||
+            (q->priority == j->priority && j->probed && !q->probed))
+            break;
+        pos++;
+    }
+    g_ptr_array_insert(w->dl_waiting, pos, j);
 
-    /* We force final container to mkv so we know the file path */
-    gchar *argv[] = {
-        (gchar *)PYTHON_PROG, (gchar *)YTDLP_PATH,
-        "--newline",
-        "-f", "bv*+ba/b",
-        "--merge-output-format", "mkv",
-        "-o", (gchar *)YTDLP_TMP_FILE,
-        "--progress-template",
-        "progress:[downloaded=%(progress.downloaded_bytes)s total=%(progress.total_bytes)s eta=%(progress.eta)s speed=%(progress.speed)s percent=%(progress._percent_str)s]",
-        (gchar *)url,
-        NULL
-    };
+    gtk_label_set_text(j->status_label, "Queued for download…");
+    dl_sched_pump(w);
+}
 
-    GError *err = NULL;
-    gint stdout_fd = -1;
+/* Probe exited (or was killed by cancel_job): free its slot and queue
+   the job again for disk admission and the actual download */
+static void
+ytdlp_probe_done(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    Job *j = user_data;
+    AppWidgets *w = j->app;
+    char *out = NULL;
 
-    gboolean ok = g_spawn_async_with_pipes(
-        NULL, argv, NULL,
-        G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
-        NULL, NULL,
-        &w->yt_pid,
-        NULL, &stdout_fd, NULL,
-        &err
-    );
+    /* "NA" when yt-dlp doesn't know -> 0 -> SCRATCH_DEFAULT_SIZE */
+    if (g_subprocess_communicate_utf8_finish(G_SUBPROCESS(source), res, &out, NULL, NULL) && out)
+        j->expected_bytes = g_ascii_strtoull(out, NULL, 10);
+    g_free(out);
+    g_clear_object(&j->probe);
+    j->probed = TRUE;
+    g_ptr_array_remove(w->dl_running, j);
 
-    if (!ok) {
-        gtk_label_set_text(w->status_label, err->message);
-        g_error_free(err);
-        w->yt_pid = 0;
+    if (j->cancel_requested) {
+        job_finish(j, "Canceled.");
         return;
     }
+    dl_sched_enqueue(j);
+}
 
-    gtk_label_set_text(w->status_label, "Downloading from YouTube…");
-
-    w->yt_io = g_io_channel_unix_new(stdout_fd);
-    g_io_channel_set_encoding(w->yt_io, NULL, NULL);
-    g_io_channel_set_buffered(w->yt_io, TRUE);
-    g_io_add_watch(w->yt_io, G_IO_IN | G_IO_HUP | G_IO_ERR, ytdlp_progress_cb, w);
+/* New download job: probed and admitted as slots and disk space allow */
+static void
+dl_sched_submit(Job *j)
+{
+    dl_sched_enqueue(j);
+}
 
-    g_child_watch_add(w->yt_pid, child_watch_ytdlp, w);
+/* yt-dlp exited: free its slot and let the next one in */
+static void
+dl_sched_done(Job *j)
+{
+    AppWidgets *w = j->app;
+    j->dl_paused = FALSE;
+    g_ptr_array_remove(w->dl_running, j);
+    dl_sched_pump(w);
 }
 
 /* ---------- ffmpeg progress ---------- */
@@ -398,7 +1808,7 @@ start_ytdlp(AppWidgets *w, const char *url, const char *output)
 static gboolean
 ffmpeg_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
 {
-    AppWidgets *w = data;
+    Job *j = data;
     if (cond & (G_IO_HUP | G_IO_ERR)) return FALSE;
 
     gchar *line = NULL;
@@ -416,18 +1826,18 @@ ffmpeg_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
             /* keep last known tx_eta_sec using a cached speed_x (we'll store it in tx_eta_sec derivation below) */
 
             /* we don't have speed yet here; leave eta calc to when speed seen */
-            if (w->total_duration > 0) {
-                gdouble remain_media = w->total_duration - elapsed_media;
+            if (j->total_duration > 0) {
+                gdouble remain_media = j->total_duration - elapsed_media;
                 if (remain_media < 0) remain_media = 0;
                 /* If we already estimated a speed via previous lines, store it in tx_eta_sec as wall time */
                 /* We'll recompute once we parse a speed line; for now, rough real-time */
                 gdouble eta_guess = remain_media / speed_x;
-                w->tx_eta_sec = eta_guess;
-                w->tx_progress_0_1 = elapsed_media / w->total_duration;
-                if (w->tx_progress_0_1 < 0) w->tx_progress_0_1 = 0;
-                if (w->tx_progress_0_1 > 1) w->tx_progress_0_1 = 1;
+                j->tx_eta_sec = eta_guess;
+                j->tx_progress_0_1 = elapsed_media / j->total_duration;
+                if (j->tx_progress_0_1 < 0) j->tx_progress_0_1 = 0;
+                if (j->tx_progress_0_1 > 1) j->tx_progress_0_1 = 1;
             }
-            update_unified_progress(w);
+            update_unified_progress(j);
         } else if (g_str_has_prefix(line, "speed=")) {
             /* speed like: speed=1.23x */
             const char *s = line + 6;
@@ -436,16 +1846,16 @@ ffmpeg_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
 
             /* we need an estimate of remain_media again; we don't store elapsed_media here,
                but tx_progress_0_1 gives us a fraction. */
-            if (w->total_duration > 0) {
-                gdouble elapsed_media = w->tx_progress_0_1 * w->total_duration;
-                gdouble remain_media = w->total_duration - elapsed_media;
+            if (j->total_duration > 0) {
+                gdouble elapsed_media = j->tx_progress_0_1 * j->total_duration;
+                gdouble remain_media = j->total_duration - elapsed_media;
                 if (remain_media < 0) remain_media = 0;
-                w->tx_eta_sec = remain_media / speed_x;
+                j->tx_eta_sec = remain_media / speed_x;
             }
-            update_unified_progress(w);
+            update_unified_progress(j);
         } else if (g_str_has_prefix(line, "progress=end")) {
-            w->tx_eta_sec = 0;
-            update_unified_progress(w);
+            j->tx_eta_sec = 0;
+            update_unified_progress(j);
         }
 
         g_free(line);
@@ -461,87 +1871,285 @@ ffmpeg_progress_cb(GIOChannel *source, GIOCondition cond, gpointer data)
     return TRUE;
 }
 
+static gboolean spawn_ffmpeg(Job *j, GPtrArray *outputs, gboolean draft);
+
+/* Move a finished temp file over its final path (atomically replacing any
+   draft or older file); on failure/cancel just drop it, so whatever was
+   at the path before stays in place */
+static gboolean
+commit_temp_file(char **tmp, const char *path, gboolean keep, GError **error)
+{
+    gboolean ok = TRUE;
+    if (!*tmp) return TRUE;
+    if (keep) {
+        if (rename(*tmp, path) != 0) {
+            int err = errno;
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+                        "Cannot replace '%s': %s", path, g_strerror(err));
+            ok = FALSE;
+            unlink(*tmp);
+        }
+    } else {
+        unlink(*tmp);
+    }
+    g_clear_pointer(tmp, g_free);
+    return ok;
+}
+
+/* Commit (or drop) the drafts, or the partials of the final pass; after
+   the first failure the remaining ones are dropped */
+static gboolean
+commit_partials(Job *j, gboolean drafts, gboolean keep, GError **error)
+{
+    gboolean ok = TRUE;
+    for (guint i = 0; i < j->outputs->len; i++) {
+        OutputSpec *o = j->outputs->pdata[i];
+        gboolean had = (drafts ? o->draft : o->partial) != NULL;
+        gboolean commit = keep && ok;
+        ok = commit_temp_file(drafts ? &o->draft : &o->partial, o->path,
+                              commit, ok ? error : NULL) && ok;
+        if (had && commit && ok)
+            o->draft_left = drafts;
+    }
+    return ok;
+}
+
+/* The final pass did not make it: say so, and say where a committed
+   draft now sits in place of what was at the output path before (it is
+   kept rather than removed, the older file is gone either way).
+   status NULL keeps the current text, e.g. a spawn error. */
+static void
+job_finish_final(Job *j, const char *status)
+{
+    GString *msg = g_string_new(status ? status : gtk_label_get_text(j->status_label));
+    const char *first = NULL;
+    guint n = 0;
+    for (guint i = 0; i < j->outputs->len; i++) {
+        OutputSpec *o = j->outputs->pdata[i];
+        if (!o->draft_left) continue;
+        if (!first) first = o->path;
+        n++;
+    }
+    if (first) {
+        g_string_append_printf(msg, " Low-res draft left at %s", first);
+        if (n > 1) g_string_append_printf(msg, " (+%u more)", n - 1);
+        g_string_append_c(msg, '.');
+    }
+    job_finish(j, msg->str);
+    g_string_free(msg, TRUE);
+}
+
+/* Draft done: report it and start the full-quality pass into partials */
+static void
+start_final_after_draft(Job *j, gboolean draft_ok)
+{
+    char *msg = draft_ok
+        ? g_strdup_printf("Draft ready: %s — encoding full quality…",
+                          ((OutputSpec *)j->outputs->pdata[0])->path)
+        : g_strdup("Draft failed. Encoding full quality…");
+    gtk_label_set_text(j->status_label, msg);
+    g_free(msg);
+
+    j->phase = PHASE_TRANSCODING;
+    j->t_start_us = g_get_monotonic_time();
+    j->tx_eta_sec = 0;
+    j->tx_progress_0_1 = 0;
+    if (!spawn_ffmpeg(j, j->outputs, FALSE)) {
+        commit_partials(j, FALSE, FALSE, NULL);
+        job_finish_final(j, NULL);
+        return;
+    }
+    gtk_progress_bar_set_fraction(j->progress_bar, 0.0);
+}
+
 static void
 child_watch_ffmpeg(GPid pid, gint status, gpointer user_data)
 {
-    AppWidgets *w = user_data;
+    Job *j = user_data;
 
-    if (w->ff_io) {
-        g_io_channel_shutdown(w->ff_io, FALSE, NULL);
-        g_io_channel_unref(w->ff_io);
-        w->ff_io = NULL;
+    if (j->ff_io) {
+        g_io_channel_shutdown(j->ff_io, FALSE, NULL);
+        g_io_channel_unref(j->ff_io);
+        j->ff_io = NULL;
     }
     g_spawn_close_pid(pid);
-    w->ffmpeg_pid = 0;
+    j->ffmpeg_pid = 0;
+
+    gboolean ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
 
-    if (w->cancel_requested) {
-        gtk_label_set_text(w->status_label, "Canceled.");
-        gtk_progress_bar_set_fraction(w->progress_bar, 0.0);
+    if (j->cancel_requested) {
+        commit_partials(j, TRUE, FALSE, NULL);
+        commit_partials(j, FALSE, FALSE, NULL);
+        gtk_progress_bar_set_fraction(j->progress_bar, 0.0);
+        job_finish_final(j, "Canceled.");
         return;
     }
 
-    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-        gtk_label_set_text(w->status_label, "Conversion finished.");
-        gtk_progress_bar_set_fraction(w->progress_bar, 1.0);
-        gtk_label_set_text(w->progress_label, "00:00:00");
-    } else {
-        gtk_label_set_text(w->status_label, "Conversion failed.");
+    if (j->phase == PHASE_DRAFTING) {
+        /* a failed or half-written draft never reaches the output path */
+        start_final_after_draft(j, commit_partials(j, TRUE, ok, NULL) && ok);
+        return;
     }
-}
-
-/* ---------- original local-file ffmpeg path (kept) ---------- */
 
-static void
-start_ffmpeg_conversion(AppWidgets *w, const char *input, const char *output)
-{
-    if (w->ffmpeg_pid != 0 || w->yt_pid != 0) {
-        gtk_label_set_text(w->status_label, "A job is already running.");
+    GError *err = NULL;
+    if (!commit_partials(j, FALSE, ok, &err)) {
+        job_finish_final(j, err->message);
+        g_error_free(err);
         return;
     }
 
-    w->phase = PHASE_TRANSCODING;
-    w->t_start_us = g_get_monotonic_time();
-    w->dl_eta_sec = 0;
-    w->tx_eta_sec = 0;
-    w->cancel_requested = FALSE;
+    if (ok) {
+        GString *msg = g_string_new("Conversion finished");
+        if (j->outputs->len > 1)
+            g_string_append_printf(msg, " (%u outputs)", j->outputs->len);
+        g_string_append_c(msg, '.');
+        if (j->skipped)
+            g_string_append_printf(msg, " No audio in the input, skipped %s.", j->skipped);
+        job_finish(j, msg->str);
+        g_string_free(msg, TRUE);
+        preview_publish(j, FALSE); /* the output path is this job's now */
+        gtk_progress_bar_set_fraction(j->progress_bar, 1.0);
+        gtk_label_set_text(j->progress_label, "00:00:00");
+    } else {
+        job_finish_final(j, "Conversion failed.");
+    }
+}
 
-    gchar *argv[] = {
-        "ffmpeg",
-        "-y",
-        "-i", (gchar *)input,
-        "-progress", "pipe:2",
-        "-nostats",
-        (gchar *)output,
-        NULL
-    };
+/* Start one ffmpeg pass producing every entry of outputs from j->input_path */
+static gboolean
+spawn_ffmpeg(Job *j, GPtrArray *outputs, gboolean draft)
+{
+    GPtrArray *argv = build_ffmpeg_argv(j->input_path, outputs, draft);
+
+    /* the preview is published as soon as ffmpeg starts: make sure it can
+       only ever see what this pass writes, not a leftover temp file */
+    for (guint i = 0; i < outputs->len; i++) {
+        OutputSpec *o = outputs->pdata[i];
+        const char *tmp = draft ? o->draft : o->partial;
+        if (tmp) unlink(tmp);
+    }
 
-    gint stderr_fd;
+    gint stderr_fd = -1;
     GError *err = NULL;
     gboolean ok = g_spawn_async_with_pipes(
-        NULL, argv, NULL,
+        NULL, (gchar **)argv->pdata, NULL,
         G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
-        NULL, NULL, &w->ffmpeg_pid,
+        NULL, NULL, &j->ffmpeg_pid,
         NULL, NULL, &stderr_fd,
         &err
     );
+    g_ptr_array_unref(argv);
 
     if (!ok) {
-        gtk_label_set_text(w->status_label, err->message);
+        gtk_label_set_text(j->status_label, err->message);
         g_error_free(err);
-        w->ffmpeg_pid = 0;
-        return;
+        j->ffmpeg_pid = 0;
+        return FALSE;
+    }
+
+    j->ff_io = g_io_channel_unix_new(stderr_fd);
+    g_io_channel_set_encoding(j->ff_io, NULL, NULL);
+    g_io_channel_set_buffered(j->ff_io, TRUE);
+    g_io_add_watch(j->ff_io, G_IO_IN | G_IO_HUP | G_IO_ERR, ffmpeg_progress_cb, j);
+
+    g_child_watch_add(j->ffmpeg_pid, child_watch_ffmpeg, j);
+    preview_publish(j, TRUE);
+    return TRUE;
+}
+
+/* A source without audio makes ffmpeg reject the whole fan-out over one
+   "-map 0:a:0", taking the video outputs down with it: leave the audio
+   outputs out instead (reported in the final status). FALSE if that
+   leaves nothing to encode. */
+static gboolean
+drop_audio_outputs_if_silent(Job *j)
+{
+    gboolean any_audio = FALSE;
+    for (guint i = 0; i < j->outputs->len; i++)
+        if (is_audio_format(((OutputSpec *)j->outputs->pdata[i])->format)) any_audio = TRUE;
+    if (!any_audio || media_has_audio(j->input_path)) return TRUE;
+
+    GString *names = g_string_new(NULL);
+    for (guint i = 0; i < j->outputs->len; ) {
+        OutputSpec *o = j->outputs->pdata[i];
+        if (!is_audio_format(o->format)) {
+            i++;
+            continue;
+        }
+        char *base = g_path_get_basename(o->path);
+        if (names->len) g_string_append(names, ", ");
+        g_string_append(names, base);
+        g_free(base);
+        g_ptr_array_remove_index(j->outputs, i); /* frees o */
+    }
+    j->skipped = g_string_free(names, FALSE);
+
+    if (j->outputs->len == 0) {
+        gtk_label_set_text(j->status_label, "The input has no audio stream.");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Encode j->input_path (already downloaded and probed) into j->outputs.
+   In draft mode the video outputs are first written as a quick low-res
+   draft; the final pass then reuses the same input and duration. */
+static gboolean
+start_transcode(Job *j)
+{
+    if (!drop_audio_outputs_if_silent(j)) return FALSE;
+
+    if (j->draft_mode) {
+        GPtrArray *drafts = g_ptr_array_new();
+        for (guint i = 0; i < j->outputs->len; i++) {
+            OutputSpec *o = j->outputs->pdata[i];
+            if (!is_audio_format(o->format) && !is_image_format(o->format))
+                g_ptr_array_add(drafts, o);
+        }
+        gboolean ok = FALSE;
+        if (drafts->len > 0) {
+            j->phase = PHASE_DRAFTING;
+            ok = spawn_ffmpeg(j, drafts, TRUE);
+        }
+        g_ptr_array_unref(drafts);
+        if (ok) {
+            gtk_label_set_text(j->status_label, "Encoding draft…");
+            return TRUE;
+        }
+        commit_partials(j, TRUE, FALSE, NULL);
+        /* nothing to draft (or draft could not start): go straight to final */
     }
 
-    w->ff_io = g_io_channel_unix_new(stderr_fd);
-    g_io_channel_set_encoding(w->ff_io, NULL, NULL);
-    g_io_channel_set_buffered(w->ff_io, TRUE);
-    g_io_add_watch(w->ff_io, G_IO_IN | G_IO_HUP | G_IO_ERR, ffmpeg_progress_cb, w);
+    j->phase = PHASE_TRANSCODING;
+    return spawn_ffmpeg(j, j->outputs, FALSE);
+}
+
+/* ---------- original local-file ffmpeg path (kept) ---------- */
+
+static void
+start_ffmpeg_conversion(Job *j)
+{
+    j->t_start_us = g_get_monotonic_time();
+    j->dl_eta_sec = 0;
+    j->tx_eta_sec = 0;
 
-    g_child_watch_add(w->ffmpeg_pid, child_watch_ffmpeg, w);
+    gtk_label_set_text(j->status_label, "Converting…");
+    if (!start_transcode(j)) {
+        job_finish(j, NULL);
+        return;
+    }
+
+    gtk_progress_bar_set_fraction(j->progress_bar, 0.0);
+    gtk_label_set_text(j->progress_label, "Calculating…");
+}
 
-    gtk_label_set_text(w->status_label, "Converting…");
-    gtk_progress_bar_set_fraction(w->progress_bar, 0.0);
-    gtk_label_set_text(w->progress_label, "Calculating…");
+/* Local file admitted on disk: probe it once (draft + final share the
+   duration) and convert */
+static void
+start_local_job(Job *j)
+{
+    j->total_duration = get_media_duration(j->input_path);
+    start_ffmpeg_conversion(j);
 }
 
 /* ---------- dialogs ---------- */
@@ -599,17 +2207,38 @@ on_browse_output_clicked(GtkButton *btn, gpointer user_data)
 }
 
 static void
-cancel_running(AppWidgets *w)
+cancel_job(Job *j)
 {
-    w->cancel_requested = TRUE;
-    if (w->yt_pid) {
-        kill(w->yt_pid, SIGTERM);
+    AppWidgets *w = j->app;
+
+    if (g_ptr_array_remove(w->dl_waiting, j) || g_ptr_array_remove(w->local_waiting, j)) {
+        job_finish(j, "Canceled.");
+        return;
+    }
+
+    j->cancel_requested = TRUE;
+    if (j->probe)
+        g_subprocess_force_exit(j->probe);
+    if (j->yt_pid) {
+        /* whole group; a paused download has to be continued to see SIGTERM */
+        kill(-j->yt_pid, SIGTERM);
+        kill(-j->yt_pid, SIGCONT);
     }
-    if (w->ffmpeg_pid) {
+    if (j->ffmpeg_pid) {
         /* ffmpeg honors SIGTERM; if you want, send "q" to stdin if you wired it */
-        kill(w->ffmpeg_pid, SIGTERM);
+        kill(j->ffmpeg_pid, SIGTERM);
+    }
+    gtk_label_set_text(j->status_label, "Canceling…");
+}
+
+static void
+cancel_running(AppWidgets *w)
+{
+    for (guint i = 0; i < w->jobs->len; i++) {
+        Job *j = w->jobs->pdata[i];
+        if (j->active && !j->cancel_requested)
+            cancel_job(j);
     }
-    gtk_label_set_text(w->status_label, "Canceling…");
 }
 
 static void
@@ -619,6 +2248,28 @@ on_cancel_clicked(GtkButton *btn, gpointer user_data)
     cancel_running(w);
 }
 
+static void
+on_job_cancel_clicked(GtkButton *btn, gpointer user_data)
+{
+    Job *j = user_data;
+    if (j->active && !j->cancel_requested)
+        cancel_job(j);
+}
+
+static Job *
+find_active_output(AppWidgets *w, const char *path)
+{
+    for (guint i = 0; i < w->jobs->len; i++) {
+        Job *j = w->jobs->pdata[i];
+        if (!j->active) continue;
+        for (guint k = 0; k < j->outputs->len; k++) {
+            OutputSpec *o = j->outputs->pdata[k];
+            if (g_strcmp0(o->path, path) == 0) return j;
+        }
+    }
+    return NULL;
+}
+
 static void
 on_convert_clicked(GtkButton *btn, gpointer user_data)
 {
@@ -626,39 +2277,64 @@ on_convert_clicked(GtkButton *btn, gpointer user_data)
     const char *input = gtk_editable_get_text(GTK_EDITABLE(w->input_entry));
     const char *output_raw = gtk_editable_get_text(GTK_EDITABLE(w->output_entry));
 
-    guint sel = gtk_drop_down_get_selected(w->format_dropdown);
-    GtkStringList *slist = GTK_STRING_LIST(gtk_drop_down_get_model(w->format_dropdown));
-    const char *fmt = gtk_string_list_get_string(slist, sel);
-
     if (!input || !*input || !output_raw || !*output_raw) {
         gtk_label_set_text(w->status_label, "Select input and output first.");
         return;
     }
 
-    char *output = append_extension_if_missing(output_raw, fmt);
-
     GError *err = NULL;
-    if (!ensure_output_path(output, &err)) {
+    GPtrArray *outputs = collect_outputs(w, output_raw, &err);
+    if (!outputs) {
         gtk_label_set_text(w->status_label, err->message);
         g_error_free(err);
-        g_free(output);
         return;
     }
-    g_free(output);
 
-    /* If it's a YouTube URL, run the two-phase (download -> transcode) with a single shared bar */
-    if (is_youtube_url(input)) {
-        char *fixed_output = append_extension_if_missing(output_raw, fmt);
-        start_ytdlp(w, input, fixed_output);
-        g_free(fixed_output);
+    for (guint i = 0; i < outputs->len; i++) {
+        OutputSpec *o = outputs->pdata[i];
+        Job *owner = find_active_output(w, o->path);
+        if (owner) {
+            char *msg = g_strdup_printf("'%s' is already being written by job #%u.",
+                                        o->path, owner->id);
+            gtk_label_set_text(w->status_label, msg);
+            g_free(msg);
+            g_ptr_array_unref(outputs);
+            return;
+        }
+        if (!ensure_output_path(o->path, &err)) {
+            gtk_label_set_text(w->status_label, err->message);
+            g_error_free(err);
+            g_ptr_array_unref(outputs);
+            return;
+        }
+    }
+
+    Job *j = job_new(w, input, outputs);
+    gtk_label_set_text(w->status_label, "");
+
+    /* If it's a YouTube URL, queue the two-phase (download -> transcode) with a single shared bar */
+    if (j->url) {
+        dl_sched_submit(j);
+        return;
+    }
+
+    /* else: local file -> ffmpeg only, once its outputs fit on disk */
+    struct stat st;
+    if (stat(j->input_path, &st) == 0)
+        j->expected_bytes = (guint64)st.st_size;
+    if (!scratch_admit(j, &err)) {
+        if (err) {
+            job_finish(j, err->message);
+            g_error_free(err);
+            return;
+        }
+        /* retried by dl_sched_kick whenever another job gives space back */
+        gtk_label_set_text(j->status_label, "Waiting for free disk space…");
+        g_ptr_array_add(w->local_waiting, j);
         return;
     }
 
-    /* else: local file -> single-phase ffmpeg */
-    char *fixed_output = append_extension_if_missing(output_raw, fmt);
-    w->total_duration = get_media_duration(input);
-    start_ffmpeg_conversion(w, input, fixed_output);
-    g_free(fixed_output);
+    start_local_job(j);
 }
 
 /* ---------- UI setup ---------- */
@@ -668,7 +2344,7 @@ activate(GtkApplication *app, gpointer user_data)
 {
     GtkWidget *win = gtk_application_window_new(app);
     gtk_window_set_title(GTK_WINDOW(win), "Betinha");
-    gtk_window_set_default_size(GTK_WINDOW(win), 560, 390);
+    gtk_window_set_default_size(GTK_WINDOW(win), 620, 640);
 
     GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
     gtk_widget_set_margin_top(vbox, 12);
@@ -678,6 +2354,10 @@ activate(GtkApplication *app, gpointer user_data)
     gtk_window_set_child(GTK_WINDOW(win), vbox);
 
     AppWidgets *w = g_new0(AppWidgets, 1);
+    w->jobs = g_ptr_array_new();
+    w->dl_waiting = g_ptr_array_new();
+    w->dl_running = g_ptr_array_new();
+    w->local_waiting = g_ptr_array_new();
 
     /* Input row */
     GtkWidget *in_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
@@ -709,17 +2389,51 @@ activate(GtkApplication *app, gpointer user_data)
 
     /* Format dropdown */
     gtk_box_append(GTK_BOX(vbox), gtk_label_new("Output format:"));
-    const char *formats[] = {"PNG", "JPEG", "WEBP", "GIF", "MP4", "MP3", NULL};
-    GtkStringList *slist = gtk_string_list_new(formats);
+    GtkStringList *slist = gtk_string_list_new(FORMATS);
     w->format_dropdown = GTK_DROP_DOWN(gtk_drop_down_new(G_LIST_MODEL(slist), NULL));
     gtk_drop_down_set_selected(w->format_dropdown, 4); /* default to MP4 */
     gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->format_dropdown));
 
+    /* Extra formats/sizes, produced from the same decode pass */
+    gtk_box_append(GTK_BOX(vbox), gtk_label_new("Also produce (same pass):"));
+    GtkWidget *extra_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_widget_set_halign(extra_row, GTK_ALIGN_CENTER);
+    for (int i = 0; i < N_FORMATS; i++) {
+        w->extra_checks[i] = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(FORMATS[i]));
+        gtk_box_append(GTK_BOX(extra_row), GTK_WIDGET(w->extra_checks[i]));
+    }
+    gtk_box_append(GTK_BOX(vbox), extra_row);
+
+    w->sizes_entry = GTK_ENTRY(gtk_entry_new());
+    gtk_entry_set_placeholder_text(w->sizes_entry, "Sizes (heights, optional): e.g. 720,480");
+    gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->sizes_entry));
+
+    w->draft_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(
+        "Quick draft first (low-res, replaced by the full-quality encode)"));
+    gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->draft_check));
+
+    w->live_check = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(
+        "Live preview (fragmented MP4, playable while encoding)"));
+    gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->live_check));
+
+    /* Scheduling: job priority + global download cap */
+    GtkWidget *sched_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_widget_set_halign(sched_row, GTK_ALIGN_CENTER);
+    w->priority_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(1, 10, 1));
+    gtk_spin_button_set_value(w->priority_spin, 5);
+    w->bw_cap_spin = GTK_SPIN_BUTTON(gtk_spin_button_new_with_range(0, 1000000, 256));
+    gtk_spin_button_set_value(w->bw_cap_spin, 0);
+    gtk_box_append(GTK_BOX(sched_row), gtk_label_new("Priority:"));
+    gtk_box_append(GTK_BOX(sched_row), GTK_WIDGET(w->priority_spin));
+    gtk_box_append(GTK_BOX(sched_row), gtk_label_new("Download cap (KiB/s, 0 = none):"));
+    gtk_box_append(GTK_BOX(sched_row), GTK_WIDGET(w->bw_cap_spin));
+    gtk_box_append(GTK_BOX(vbox), sched_row);
+
     /* Buttons row: Convert + Cancel */
     GtkWidget *btn_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     gtk_widget_set_halign(btn_row, GTK_ALIGN_CENTER);
     w->convert_btn = GTK_BUTTON(gtk_button_new_with_label("Convert"));
-    w->cancel_btn  = GTK_BUTTON(gtk_button_new_with_label("Cancel"));
+    w->cancel_btn  = GTK_BUTTON(gtk_button_new_with_label("Cancel all"));
     gtk_box_append(GTK_BOX(btn_row), GTK_WIDGET(w->convert_btn));
     gtk_box_append(GTK_BOX(btn_row), GTK_WIDGET(w->cancel_btn));
     gtk_box_append(GTK_BOX(vbox), btn_row);
@@ -727,17 +2441,16 @@ activate(GtkApplication *app, gpointer user_data)
     g_signal_connect(w->convert_btn, "clicked", G_CALLBACK(on_convert_clicked), w);
     g_signal_connect(w->cancel_btn,  "clicked", G_CALLBACK(on_cancel_clicked),  w);
 
-    /* Progress bar + ETA label + status */
-    w->progress_bar = GTK_PROGRESS_BAR(gtk_progress_bar_new());
-    gtk_progress_bar_set_show_text(w->progress_bar, TRUE);
-    gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->progress_bar));
-
-    w->progress_label = GTK_LABEL(gtk_label_new("00:00:00"));
-    gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->progress_label));
-
+    /* Status + jobs list (one progress bar / ETA / status per job) */
     w->status_label = GTK_LABEL(gtk_label_new(""));
     gtk_box_append(GTK_BOX(vbox), GTK_WIDGET(w->status_label));
 
+    w->jobs_list = GTK_LIST_BOX(gtk_list_box_new());
+    GtkWidget *scroll = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scroll), GTK_WIDGET(w->jobs_list));
+    gtk_widget_set_vexpand(scroll, TRUE);
+    gtk_box_append(GTK_BOX(vbox), scroll);
+
     gtk_window_present(GTK_WINDOW(win));
 }
 
@@ -745,9 +2458,12 @@ activate(GtkApplication *app, gpointer user_data)
 
 int main(int argc, char *argv[])
 {
+    scratch_cleanup_stale();
+
     GtkApplication *app = gtk_application_new("com.example.ffmpeg.converter", G_APPLICATION_DEFAULT_FLAGS);
     g_signal_connect(app, "activate", G_CALLBACK(activate), NULL);
     int st = g_application_run(G_APPLICATION(app), argc, argv);
     g_object_unref(app);
+    scratch_manifest_done();
     return st;
 }
\ No newline at end of file